@@ -52,6 +52,7 @@ endif
 ifeq ($(strip $(COMBO_ENABLE)), yes)
     OPT_DEFS += -DCOMBO_ENABLE
     SRC += $(QUANTUM_DIR)/process_keycode/process_combo.c
+    DEFERRED_EXEC_ENABLE = yes
 endif
 
 ifeq ($(strip $(VIRTSER_ENABLE)), yes)
@@ -82,6 +83,7 @@ ifeq ($(strip $(UNICODE_ENABLE)), yes)
 endif
 
 ifeq ($(strip $(UNICODE_COMMON)), yes)
+    OPT_DEFS += -DKEYBOARD_REPORT_QUEUE
     SRC += $(QUANTUM_DIR)/process_keycode/process_unicode_common.c
 endif
 
@@ -96,6 +98,12 @@ endif
 ifeq ($(strip $(TAP_DANCE_ENABLE)), yes)
     OPT_DEFS += -DTAP_DANCE_ENABLE
     SRC += $(QUANTUM_DIR)/process_keycode/process_tap_dance.c
+    DEFERRED_EXEC_ENABLE = yes
+endif
+
+ifeq ($(strip $(DYNAMIC_MACRO_ENABLE)), yes)
+    OPT_DEFS += -DDYNAMIC_MACRO_ENABLE
+    DEFERRED_EXEC_ENABLE = yes
 endif
 
 ifeq ($(strip $(PRINTING_ENABLE)), yes)
@@ -144,6 +152,7 @@ endif
 
 QUANTUM_SRC:= \
     $(QUANTUM_DIR)/quantum.c \
+    $(QUANTUM_DIR)/send_string_layouts.c \
     $(QUANTUM_DIR)/keymap_common.c \
     $(QUANTUM_DIR)/keycode_config.c \
     $(QUANTUM_DIR)/process_keycode/process_leader.c
@@ -1101,8 +1101,6 @@ void qk_ucis_symbol_fallback (void) {
       code = qk_ucis_state.codes[i] - M(A_1) + KC_1;
     else
       code = qk_ucis_state.codes[i];
-    register_code(code);
-    unregister_code(code);
-    wait_ms (10);
+    unicode_tap_code(code);
   }
 }
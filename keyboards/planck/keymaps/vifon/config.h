@@ -82,9 +82,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define PREVENT_STUCK_MODIFIERS
 
 /* A larger buffer for the dynamic macros as this keymap is not taking
- * up that much memory.
+ * up that much memory: about 256 events, at 2 bytes each.
  */
-#define DYNAMIC_MACRO_SIZE 256
+#define DYNAMIC_MACRO_SIZE 512
 
 #ifdef SUBPROJECT_rev3
     #include "rev3/config.h"
@@ -18,19 +18,57 @@
 #ifndef DYNAMIC_MACROS_H
 #define DYNAMIC_MACROS_H
 
+#include <string.h>
 #include "action_layer.h"
+#include "deferred_exec.h"
+#ifdef DYNAMIC_MACRO_EEPROM
+#   include "eeprom.h"
+#   include "eeconfig.h"
+#endif
+
+#ifndef DEFERRED_EXEC_ENABLE
+#   error "Dynamic macros need DYNAMIC_MACRO_ENABLE = yes in your Makefile"
+#endif
 
 #ifndef DYNAMIC_MACRO_SIZE
-/* May be overridden with a custom value. Be aware that the effective
- * macro length is half of this value: each keypress is recorded twice
- * because of the down-event and up-event. This is not a bug, it's the
- * intended behavior.
- *
- * Usually it should be fine to set the macro size to at least 256 but
- * there have been reports of it being too much in some users' cases,
- * so 128 is considered a safe default.
+/* May be overridden with a custom value. It is the number of bytes
+ * all the macros share. Each keypress is recorded twice, as a
+ * down-event and an up-event, and events less than about 250 ms apart
+ * take 2 bytes: the key, and the time since the previous event. So the
+ * default fits about 128 keypresses typed at a normal pace.
  */
-#define DYNAMIC_MACRO_SIZE 128
+#define DYNAMIC_MACRO_SIZE 512
+#endif
+
+#ifndef DYNAMIC_MACRO_SLOTS
+#define DYNAMIC_MACRO_SLOTS 2
+#endif
+
+/* The times between the events are recorded in steps of this many ms. */
+#ifndef DYNAMIC_MACRO_TIME_UNIT
+#define DYNAMIC_MACRO_TIME_UNIT 4
+#endif
+
+/* How fast the macros are played, DYN_MACRO_SPEED cycles through them. */
+enum dynamic_macro_speeds {
+    DYNAMIC_MACRO_SPEED_MAX = 0,
+    DYNAMIC_MACRO_SPEED_1X = 1,
+    DYNAMIC_MACRO_SPEED_2X = 2
+};
+
+#ifndef DYNAMIC_MACRO_SPEED_DEFAULT
+#define DYNAMIC_MACRO_SPEED_DEFAULT DYNAMIC_MACRO_SPEED_1X
+#endif
+
+#if DYNAMIC_MACRO_SLOTS < 1 || DYNAMIC_MACRO_SLOTS > 16
+#   error "DYNAMIC_MACRO_SLOTS must be between 1 and 16"
+#endif
+
+/* The keys of slot 2 are there even with a single slot. */
+#if DYNAMIC_MACRO_SLOTS > 2
+#   define DYNAMIC_MACRO_KEY_SLOTS DYNAMIC_MACRO_SLOTS
+#else
+#   define DYNAMIC_MACRO_KEY_SLOTS 2
 #endif
 
 /* DYNAMIC_MACRO_RANGE must be set as the last element of user's
@@ -43,8 +81,71 @@ enum dynamic_macro_keycodes {
     DYN_REC_STOP,
     DYN_MACRO_PLAY1,
     DYN_MACRO_PLAY2,
+    /* the keys of slot 3 and up, see DYN_REC_START(n) */
+    DYN_REC_START_MORE,
+    DYN_MACRO_PLAY_MORE = DYN_REC_START_MORE + DYNAMIC_MACRO_KEY_SLOTS - 2,
+    DYN_MACRO_SPEED = DYN_MACRO_PLAY_MORE + DYNAMIC_MACRO_KEY_SLOTS - 2,
+    DYNAMIC_MACRO_END
 };
 
+/* Keys to record and to replay macro n, counting from 1 */
+#define DYN_REC_START(n) \
+    ((n) == 1 ? DYN_REC_START1 : (n) == 2 ? DYN_REC_START2 : DYN_REC_START_MORE + (n) - 3)
+#define DYN_MACRO_PLAY(n) \
+    ((n) == 1 ? DYN_MACRO_PLAY1 : (n) == 2 ? DYN_MACRO_PLAY2 : DYN_MACRO_PLAY_MORE + (n) - 3)
+
+/* The macros are stored as a stream of events. Each event is
+ *
+ *   key    row * MATRIX_COLS + col, with the pressed flag in the top
+ *          bit: 1 byte, or 2 bytes on matrices of more than 128 keys
+ *   time   DYNAMIC_MACRO_TIME_UNIT ms steps since the previous event,
+ *          shifted left by one with the "tap follows" flag in bit 0.
+ *          Stored 7 bits per byte, low bits first, the top bit set on
+ *          all but the last byte, so up to 63 steps take one byte
+ *   tap    only when flagged: the tap count, and the interrupted
+ *          flag in the top bit
+ *
+ * The keycode isn't stored: it is looked up again when the macro is
+ * played.
+ */
+#if MATRIX_ROWS * MATRIX_COLS <= 128
+#   define DYNAMIC_MACRO_KEY_BYTES 1
+#else
+#   define DYNAMIC_MACRO_KEY_BYTES 2
+#endif
+#define DYNAMIC_MACRO_EVENT_MAX (DYNAMIC_MACRO_KEY_BYTES + 3 + 1)
+
+/* The slots are kept back to back, in order. While a slot is being
+ * recorded, the slots after it are moved to the end of the buffer so
+ * that the free space follows it.
+ */
+static uint8_t dynamic_macro_buffer[DYNAMIC_MACRO_SIZE];
+static uint16_t dynamic_macro_length[DYNAMIC_MACRO_SLOTS];
+
+/* The slot being recorded, -1 when none is. */
+static int8_t dynamic_macro_recording = -1;
+/* Where the recorded slot starts, and the free space it can use. */
+static uint16_t dynamic_macro_rec_start;
+static uint16_t dynamic_macro_rec_space;
+static uint16_t dynamic_macro_rec_length;
+/* The length up to the last up-event, to trim the trailing down-events. */
+static uint16_t dynamic_macro_rec_trimmed;
+static uint16_t dynamic_macro_rec_time;
+
+/* Position of the macro being played, and where it ends. */
+static bool dynamic_macro_playing = false;
+static deferred_token dynamic_macro_play_token;
+static uint16_t dynamic_macro_play_pos;
+static uint16_t dynamic_macro_play_end;
+/* The layers the events of the macro are looked up on. Like while it
+ * was recorded, they start all off and only change with the layer keys
+ * of the macro, whatever the user does meanwhile.
+ */
+static uint32_t dynamic_macro_play_layer_state;
+/* The keys the macro holds down, a bit for each. */
+static uint8_t dynamic_macro_play_held[(MATRIX_ROWS * MATRIX_COLS + 7) / 8];
+static uint8_t dynamic_macro_speed = DYNAMIC_MACRO_SPEED_DEFAULT;
+
 /* Blink the LEDs to notify the user about some event. */
 void dynamic_macro_led_blink(void)
 {
@@ -55,23 +156,126 @@ void dynamic_macro_led_blink(void)
 #endif
 }
 
-/* Convenience macros used for retrieving the debug info. All of them
- * need a `direction` variable accessible at the call site.
+/* Where the slot starts in the buffer. */
+uint16_t dynamic_macro_slot_start(uint8_t slot)
+{
+    uint16_t start = 0;
+    for (uint8_t i = 0; i < slot; i++) {
+        start += dynamic_macro_length[i];
+    }
+    return start;
+}
+
+/* Bytes used by the slots after this one. */
+uint16_t dynamic_macro_used_after(uint8_t slot)
+{
+    uint16_t used = 0;
+    for (uint8_t i = slot + 1; i < DYNAMIC_MACRO_SLOTS; i++) {
+        used += dynamic_macro_length[i];
+    }
+    return used;
+}
+
+#ifdef DYNAMIC_MACRO_EEPROM
+/* A plain number, so that it can be checked against the EEPROM size. */
+#ifndef DYNAMIC_MACRO_EEPROM_ADDR
+#define DYNAMIC_MACRO_EEPROM_ADDR EECONFIG_SIZE
+#endif
+#if defined(E2END) && \
+    DYNAMIC_MACRO_EEPROM_ADDR + 1 + 2 * DYNAMIC_MACRO_SLOTS + DYNAMIC_MACRO_SIZE > E2END + 1
+#   error "The dynamic macros don't fit in the EEPROM, lower DYNAMIC_MACRO_SIZE"
+#endif
+/* Marks a saved copy, it changes with the number of slots. The slot
+ * lengths follow it, then the macros themselves.
  */
-#define DYNAMIC_MACRO_CURRENT_SLOT() (direction > 0 ? 1 : 2)
-#define DYNAMIC_MACRO_CURRENT_LENGTH(BEGIN, POINTER) \
-    ((int)(direction * ((POINTER) - (BEGIN))))
-#define DYNAMIC_MACRO_CURRENT_CAPACITY(BEGIN, END2) \
-    ((int)(direction * ((END2) - (BEGIN)) + 1))
+#define DYNAMIC_MACRO_EEPROM_MAGIC (0xE0 ^ DYNAMIC_MACRO_SLOTS)
+
+static bool dynamic_macro_loaded = false;
+
+/**
+ * Save the macros. Only the bytes that changed are written, and only
+ * when a recording has finished, to spare the EEPROM. They are always
+ * written to the same place: the writes are not spread over the EEPROM.
+ */
+void dynamic_macro_save(void)
+{
+    uint8_t *addr = (uint8_t *)DYNAMIC_MACRO_EEPROM_ADDR;
+    eeprom_update_byte(addr, DYNAMIC_MACRO_EEPROM_MAGIC);
+    eeprom_update_block(dynamic_macro_length, addr + 1, sizeof(dynamic_macro_length));
+    eeprom_update_block(dynamic_macro_buffer, addr + 1 + sizeof(dynamic_macro_length),
+                        dynamic_macro_slot_start(DYNAMIC_MACRO_SLOTS));
+}
+
+/**
+ * Load the macros saved before. Called once before a macro key is
+ * first used.
+ */
+void dynamic_macro_load(void)
+{
+    uint8_t *addr = (uint8_t *)DYNAMIC_MACRO_EEPROM_ADDR;
+    if (eeprom_read_byte(addr) != DYNAMIC_MACRO_EEPROM_MAGIC) {
+        return;
+    }
+    eeprom_read_block(dynamic_macro_length, addr + 1, sizeof(dynamic_macro_length));
+    uint16_t used = dynamic_macro_slot_start(DYNAMIC_MACRO_SLOTS);
+    if (used > DYNAMIC_MACRO_SIZE) {
+        dprintln("dynamic macro: saved macros don't fit, ignored");
+        memset(dynamic_macro_length, 0, sizeof(dynamic_macro_length));
+        return;
+    }
+    eeprom_read_block(dynamic_macro_buffer, addr + 1 + sizeof(dynamic_macro_length), used);
+    dprintf("dynamic macro: loaded %d bytes\n", used);
+}
+#endif
+
+/**
+ * Decode one event of a macro.
+ *
+ * @param[in]  data   The start of the event.
+ * @param[out] record The event, without its time.
+ * @param[out] delta  The ms since the previous event.
+ * @return The number of bytes the event takes.
+ */
+uint8_t dynamic_macro_decode(const uint8_t *data, keyrecord_t *record, uint16_t *delta)
+{
+    uint8_t n = 0;
+    uint16_t key = data[n++];
+#if DYNAMIC_MACRO_KEY_BYTES == 2
+    key = key << 8 | data[n++];
+    record->event.pressed = key & 0x8000;
+    key &= 0x7FFF;
+#else
+    record->event.pressed = key & 0x80;
+    key &= 0x7F;
+#endif
+    record->event.key.row = key / MATRIX_COLS;
+    record->event.key.col = key % MATRIX_COLS;
+
+    uint32_t value = 0;
+    uint8_t shift = 0;
+    do {
+        value |= (uint32_t)(data[n] & 0x7F) << shift;
+        shift += 7;
+    } while (data[n++] & 0x80);
+    *delta = (value >> 1) * DYNAMIC_MACRO_TIME_UNIT;
+
+    uint8_t tap = (value & 1) ? data[n++] : 0;
+#ifndef NO_ACTION_TAPPING
+    record->tap.count = tap & 0x0F;
+    record->tap.interrupted = tap & 0x80;
+#else
+    (void)tap;
+#endif
+    return n;
+}
 
 /**
  * Start recording of the dynamic macro.
  *
- * @param[out] macro_pointer The new macro buffer iterator.
- * @param[in]  macro_buffer  The macro buffer used to initialize macro_pointer.
+ * @param slot[in] The slot to record, counting from 0. What it held
+ *                 before is dropped.
  */
-void dynamic_macro_record_start(
-    keyrecord_t **macro_pointer, keyrecord_t *macro_buffer)
+void dynamic_macro_record_start(uint8_t slot)
 {
     dprintln("dynamic macro recording: started");
 
@@ -79,102 +283,274 @@ void dynamic_macro_record_start(
 
     clear_keyboard();
     layer_clear();
-    *macro_pointer = macro_buffer;
+
+    /* Make room right after the slot. */
+    uint16_t start = dynamic_macro_slot_start(slot);
+    uint16_t after = dynamic_macro_used_after(slot);
+    memmove(dynamic_macro_buffer + DYNAMIC_MACRO_SIZE - after,
+            dynamic_macro_buffer + start + dynamic_macro_length[slot], after);
+    dynamic_macro_length[slot] = 0;
+
+    dynamic_macro_recording = slot;
+    dynamic_macro_rec_start = start;
+    dynamic_macro_rec_space = DYNAMIC_MACRO_SIZE - after - start;
+    dynamic_macro_rec_length = 0;
+    dynamic_macro_rec_trimmed = 0;
+}
+
+/* Process an event of the macro on the layers of the macro. */
+void dynamic_macro_play_event(keyrecord_t *record)
+{
+    uint16_t key = record->event.key.row * MATRIX_COLS + record->event.key.col;
+    if (record->event.pressed) {
+        dynamic_macro_play_held[key / 8] |= 1 << (key % 8);
+    } else {
+        dynamic_macro_play_held[key / 8] &= ~(1 << (key % 8));
+    }
+    record->event.time = timer_read() | 1;
+
+#ifndef NO_ACTION_LAYER
+    uint32_t user_layer_state = layer_state;
+    layer_state = dynamic_macro_play_layer_state;
+    process_record(record);
+    if (layer_state != dynamic_macro_play_layer_state) {
+        /* A layer key of the macro ran layer_state_set_kb() with the
+         * layers of the macro, run it again with those of the user so
+         * that the LEDs and the like show them. */
+        dynamic_macro_play_layer_state = layer_state;
+        user_layer_state = layer_state_set_kb(user_layer_state);
+    }
+    layer_state = user_layer_state;
+#else
+    process_record(record);
+#endif
+}
+
+/* Ends the playback: release the keys the macro still holds, and only
+ * those, so that the keys and layers of the user are left alone.
+ */
+void dynamic_macro_play_finish(void)
+{
+    for (uint16_t key = 0; key < MATRIX_ROWS * MATRIX_COLS; key++) {
+        if (dynamic_macro_play_held[key / 8] & (1 << (key % 8))) {
+            keyrecord_t record = {};
+            record.event.key.row = key / MATRIX_COLS;
+            record.event.key.col = key % MATRIX_COLS;
+            record.event.pressed = false;
+            dynamic_macro_play_event(&record);
+        }
+    }
+    dynamic_macro_playing = false;
+}
+
+/**
+ * Send the next event of the macro being played, called back from the
+ * scan loop so that the keyboard keeps running meanwhile.
+ *
+ * @return The ms until the next event, as recorded and divided by the
+ *         speed, or 0 at the end of the macro.
+ */
+uint32_t dynamic_macro_play_next(uint32_t trigger_time, void *cb_arg)
+{
+    keyrecord_t record = {};
+    uint16_t delta;
+    dynamic_macro_play_pos += dynamic_macro_decode(
+        dynamic_macro_buffer + dynamic_macro_play_pos, &record, &delta);
+    dynamic_macro_play_event(&record);
+
+    if (dynamic_macro_play_pos >= dynamic_macro_play_end) {
+        dynamic_macro_play_finish();
+        return 0;
+    }
+
+    /* Wait as long as the user did before the next event. */
+    dynamic_macro_decode(dynamic_macro_buffer + dynamic_macro_play_pos, &record, &delta);
+    if (dynamic_macro_speed != DYNAMIC_MACRO_SPEED_MAX) {
+        delta /= dynamic_macro_speed;
+    } else {
+        delta = 0;
+    }
+    return delta ? delta : 1;
 }
 
 /**
- * Play the dynamic macro.
+ * Play the dynamic macro, with the delays between the events it was
+ * recorded with.
  *
- * @param macro_buffer[in] The beginning of the macro buffer being played.
- * @param macro_end[in]    The element after the last macro buffer element.
- * @param direction[in]    Either +1 or -1, which way to iterate the buffer.
+ * @param slot[in] The slot to play, counting from 0.
  */
-void dynamic_macro_play(
-    keyrecord_t *macro_buffer, keyrecord_t *macro_end, int8_t direction)
+void dynamic_macro_play(uint8_t slot)
 {
-    dprintf("dynamic macro: slot %d playback\n", DYNAMIC_MACRO_CURRENT_SLOT());
+    if (dynamic_macro_playing) {
+        dprintln("dynamic macro: ignoring macro play key while playing");
+        return;
+    }
+    if (!dynamic_macro_length[slot]) {
+        return;
+    }
 
-    uint32_t saved_layer_state = layer_state;
+    dprintf("dynamic macro: slot %d playback\n", slot + 1);
 
     clear_keyboard();
-    layer_clear();
 
-    while (macro_buffer != macro_end) {
-        process_record(macro_buffer);
-        macro_buffer += direction;
+    dynamic_macro_play_layer_state = 0;
+    memset(dynamic_macro_play_held, 0, sizeof(dynamic_macro_play_held));
+    dynamic_macro_play_pos = dynamic_macro_slot_start(slot);
+    dynamic_macro_play_end = dynamic_macro_play_pos + dynamic_macro_length[slot];
+    dynamic_macro_playing = true;
+
+    dynamic_macro_play_token = defer_exec(1, dynamic_macro_play_next, NULL);
+    if (dynamic_macro_play_token == INVALID_DEFERRED_TOKEN) {
+        /* No room to play it in the background, play it right away. */
+        while (dynamic_macro_play_next(0, NULL));
     }
+}
 
-    clear_keyboard();
+/* Stop the macro being played, if any. */
+void dynamic_macro_play_cancel(void)
+{
+    if (!dynamic_macro_playing) {
+        return;
+    }
+    dprintln("dynamic macro: playback cancelled");
+    cancel_deferred_exec(dynamic_macro_play_token);
+    dynamic_macro_play_finish();
+}
 
-    layer_state = saved_layer_state;
+/* Cycle the playback speed through 1x, 2x and as fast as possible. */
+void dynamic_macro_next_speed(void)
+{
+    switch (dynamic_macro_speed) {
+    case DYNAMIC_MACRO_SPEED_1X:
+        dynamic_macro_speed = DYNAMIC_MACRO_SPEED_2X;
+        break;
+    case DYNAMIC_MACRO_SPEED_2X:
+        dynamic_macro_speed = DYNAMIC_MACRO_SPEED_MAX;
+        break;
+    default:
+        dynamic_macro_speed = DYNAMIC_MACRO_SPEED_1X;
+        break;
+    }
+    dprintf("dynamic macro: speed %d\n", dynamic_macro_speed);
 }
 
 /**
  * Record a single key in a dynamic macro.
  *
- * @param macro_buffer[in] The start of the used macro buffer.
- * @param macro_pointer[in,out] The current buffer position.
- * @param macro2_end[in] The end of the other macro.
- * @param direction[in]  Either +1 or -1, which way to iterate the buffer.
- * @param record[in]     The current keypress.
+ * @param record[in] The current keypress.
  */
-void dynamic_macro_record_key(
-    keyrecord_t *macro_buffer,
-    keyrecord_t **macro_pointer,
-    keyrecord_t *macro2_end,
-    int8_t direction,
-    keyrecord_t *record)
+void dynamic_macro_record_key(keyrecord_t *record)
 {
     /* If we've just started recording, ignore all the key releases. */
-    if (!record->event.pressed && *macro_pointer == macro_buffer) {
+    if (!record->event.pressed && dynamic_macro_rec_length == 0) {
         dprintln("dynamic macro: ignoring a leading key-up event");
         return;
     }
 
-    /* The other end of the other macro is the last buffer element it
-     * is safe to use before overwriting the other macro.
-     */
-    if (*macro_pointer - direction != macro2_end) {
-        **macro_pointer = *record;
-        *macro_pointer += direction;
+    uint8_t event[DYNAMIC_MACRO_EVENT_MAX];
+    uint8_t n = 0;
+    uint16_t key = record->event.key.row * MATRIX_COLS + record->event.key.col;
+#if DYNAMIC_MACRO_KEY_BYTES == 2
+    event[n++] = (key >> 8) | (record->event.pressed ? 0x80 : 0);
+    event[n++] = key & 0xFF;
+#else
+    event[n++] = key | (record->event.pressed ? 0x80 : 0);
+#endif
+
+    uint8_t tap = 0;
+#ifndef NO_ACTION_TAPPING
+    tap = record->tap.count | (record->tap.interrupted ? 0x80 : 0);
+#endif
+    /* Whole steps from the time the previous event was stored with, so
+     * that the remainders carry over instead of adding up. */
+    uint16_t steps = 0;
+    uint16_t time = record->event.time;
+    if (dynamic_macro_rec_length) {
+        steps = TIMER_DIFF_16(record->event.time, dynamic_macro_rec_time) / DYNAMIC_MACRO_TIME_UNIT;
+        time = dynamic_macro_rec_time + steps * DYNAMIC_MACRO_TIME_UNIT;
+    }
+    uint32_t value = (uint32_t)steps << 1 | (tap ? 1 : 0);
+    do {
+        event[n] = value & 0x7F;
+        value >>= 7;
+        if (value) event[n] |= 0x80;
+        n++;
+    } while (value);
+    if (tap) {
+        event[n++] = tap;
+    }
+
+    if (dynamic_macro_rec_length + n <= dynamic_macro_rec_space) {
+        memcpy(dynamic_macro_buffer + dynamic_macro_rec_start + dynamic_macro_rec_length, event, n);
+        dynamic_macro_rec_length += n;
+        dynamic_macro_rec_time = time;
+        if (!record->event.pressed) {
+            dynamic_macro_rec_trimmed = dynamic_macro_rec_length;
+        }
     } else {
         dynamic_macro_led_blink();
     }
 
     dprintf(
         "dynamic macro: slot %d length: %d/%d\n",
-        DYNAMIC_MACRO_CURRENT_SLOT(),
-        DYNAMIC_MACRO_CURRENT_LENGTH(macro_buffer, *macro_pointer),
-        DYNAMIC_MACRO_CURRENT_CAPACITY(macro_buffer, macro2_end));
+        dynamic_macro_recording + 1,
+        dynamic_macro_rec_length,
+        dynamic_macro_rec_space);
 }
 
 /**
- * End recording of the dynamic macro. Essentially just update the
- * pointer to the end of the macro.
+ * End recording of the dynamic macro. Move the slots after it back
+ * down to follow it.
  */
-void dynamic_macro_record_end(
-    keyrecord_t *macro_buffer,
-    keyrecord_t *macro_pointer,
-    int8_t direction,
-    keyrecord_t **macro_end)
+void dynamic_macro_record_end(void)
 {
     dynamic_macro_led_blink();
 
+    uint8_t slot = dynamic_macro_recording;
+
     /* Do not save the keys being held when stopping the recording,
      * i.e. the keys used to access the layer DYN_REC_STOP is on.
      */
-    while (macro_pointer != macro_buffer &&
-           (macro_pointer - direction)->event.pressed) {
-        dprintln("dynamic macro: trimming a trailing key-down event");
-        macro_pointer -= direction;
+    if (dynamic_macro_rec_trimmed != dynamic_macro_rec_length) {
+        dprintln("dynamic macro: trimming the trailing key-down events");
     }
+    dynamic_macro_length[slot] = dynamic_macro_rec_trimmed;
+
+    uint16_t after = dynamic_macro_used_after(slot);
+    memmove(dynamic_macro_buffer + dynamic_macro_rec_start + dynamic_macro_length[slot],
+            dynamic_macro_buffer + DYNAMIC_MACRO_SIZE - after, after);
 
     dprintf(
         "dynamic macro: slot %d saved, length: %d\n",
-        DYNAMIC_MACRO_CURRENT_SLOT(),
-        DYNAMIC_MACRO_CURRENT_LENGTH(macro_buffer, macro_pointer));
+        slot + 1,
+        dynamic_macro_length[slot]);
+
+    dynamic_macro_recording = -1;
 
-    *macro_end = macro_pointer;
+#ifdef DYNAMIC_MACRO_EEPROM
+    dynamic_macro_save();
+#endif
+}
+
+/* The slot a record or play key is for, -1 for other keys. */
+int8_t dynamic_macro_rec_slot(uint16_t keycode)
+{
+    if (keycode == DYN_REC_START1) return 0;
+    if (keycode == DYN_REC_START2) return DYNAMIC_MACRO_SLOTS > 1 ? 1 : -1;
+    if (keycode >= DYN_REC_START_MORE && keycode < DYN_MACRO_PLAY_MORE) {
+        return keycode - DYN_REC_START_MORE + 2;
+    }
+    return -1;
+}
+
+int8_t dynamic_macro_play_slot(uint16_t keycode)
+{
+    if (keycode == DYN_MACRO_PLAY1) return 0;
+    if (keycode == DYN_MACRO_PLAY2) return DYNAMIC_MACRO_SLOTS > 1 ? 1 : -1;
+    if (keycode >= DYN_MACRO_PLAY_MORE && keycode < DYN_MACRO_SPEED) {
+        return keycode - DYN_MACRO_PLAY_MORE + 2;
+    }
+    return -1;
 }
 
 /* Handle the key events related to the dynamic macros. Should be
@@ -189,115 +565,65 @@ void dynamic_macro_record_end(
  */
 bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
 {
-    /* Both macros use the same buffer but read/write on different
-     * ends of it.
-     *
-     * Macro1 is written left-to-right starting from the beginning of
-     * the buffer.
-     *
-     * Macro2 is written right-to-left starting from the end of the
-     * buffer.
-     *
-     * &macro_buffer   macro_end
-     *  v                   v
-     * +------------------------------------------------------------+
-     * |>>>>>> MACRO1 >>>>>>      <<<<<<<<<<<<< MACRO2 <<<<<<<<<<<<<|
-     * +------------------------------------------------------------+
-     *                           ^                                 ^
-     *                         r_macro_end                  r_macro_buffer
-     *
-     * During the recording when one macro encounters the end of the
-     * other macro, the recording is stopped. Apart from this, there
-     * are no arbitrary limits for the macros' length in relation to
-     * each other: for example one can either have two medium sized
-     * macros or one long macro and one short macro. Or even one empty
-     * and one using the whole buffer.
-     */
-    static keyrecord_t macro_buffer[DYNAMIC_MACRO_SIZE];
-
-    /* Pointer to the first buffer element after the first macro.
-     * Initially points to the very beginning of the buffer since the
-     * macro is empty. */
-    static keyrecord_t *macro_end = macro_buffer;
-
-    /* The other end of the macro buffer. Serves as the beginning of
-     * the second macro. */
-    static keyrecord_t *const r_macro_buffer = macro_buffer + DYNAMIC_MACRO_SIZE - 1;
-
-    /* Like macro_end but for the second macro. */
-    static keyrecord_t *r_macro_end = r_macro_buffer;
-
-    /* A persistent pointer to the current macro position (iterator)
-     * used during the recording. */
-    static keyrecord_t *macro_pointer = NULL;
+#ifdef DYNAMIC_MACRO_EEPROM
+    if (!dynamic_macro_loaded) {
+        dynamic_macro_load();
+        dynamic_macro_loaded = true;
+    }
+#endif
 
-    /* 0   - no macro is being recorded right now
-     * 1,2 - either macro 1 or 2 is being recorded */
-    static uint8_t macro_id = 0;
+    if (keycode == DYN_MACRO_SPEED) {
+        if (record->event.pressed) {
+            dynamic_macro_next_speed();
+        }
+        return false;
+    }
 
-    if (macro_id == 0) {
+    if (dynamic_macro_recording == -1) {
         /* No macro recording in progress. */
+        if (keycode == DYN_REC_STOP && dynamic_macro_playing) {
+            /* Stop the macro being played. */
+            if (record->event.pressed) {
+                dynamic_macro_play_cancel();
+            }
+            return false;
+        }
         if (!record->event.pressed) {
-            switch (keycode) {
-            case DYN_REC_START1:
-                dynamic_macro_record_start(&macro_pointer, macro_buffer);
-                macro_id = 1;
-                return false;
-            case DYN_REC_START2:
-                dynamic_macro_record_start(&macro_pointer, r_macro_buffer);
-                macro_id = 2;
-                return false;
-            case DYN_MACRO_PLAY1:
-                dynamic_macro_play(macro_buffer, macro_end, +1);
+            int8_t slot = dynamic_macro_rec_slot(keycode);
+            if (slot != -1) {
+                if (dynamic_macro_playing) {
+                    dprintln("dynamic macro: ignoring macro record key while playing");
+                } else {
+                    dynamic_macro_record_start(slot);
+                }
                 return false;
-            case DYN_MACRO_PLAY2:
-                dynamic_macro_play(r_macro_buffer, r_macro_end, -1);
+            }
+            slot = dynamic_macro_play_slot(keycode);
+            if (slot != -1) {
+                dynamic_macro_play(slot);
                 return false;
             }
         }
     } else {
         /* A macro is being recorded right now. */
-        switch (keycode) {
-        case DYN_REC_STOP:
+        if (keycode == DYN_REC_STOP) {
             /* Stop the macro recording. */
             if (record->event.pressed) { /* Ignore the initial release
                                           * just after the recoding
                                           * starts. */
-                switch (macro_id) {
-                case 1:
-                    dynamic_macro_record_end(macro_buffer, macro_pointer, +1, &macro_end);
-                    break;
-                case 2:
-                    dynamic_macro_record_end(r_macro_buffer, macro_pointer, -1, &r_macro_end);
-                    break;
-                }
-                macro_id = 0;
+                dynamic_macro_record_end();
             }
             return false;
-        case DYN_MACRO_PLAY1:
-        case DYN_MACRO_PLAY2:
+        }
+        if (dynamic_macro_play_slot(keycode) != -1) {
             dprintln("dynamic macro: ignoring macro play key while recording");
             return false;
-        default:
-            /* Store the key in the macro buffer and process it normally. */
-            switch (macro_id) {
-            case 1:
-                dynamic_macro_record_key(macro_buffer, &macro_pointer, r_macro_end, +1, record);
-                break;
-            case 2:
-                dynamic_macro_record_key(r_macro_buffer, &macro_pointer, macro_end, -1, record);
-                break;
-            }
-            return true;
-            break;
         }
+        /* Store the key in the macro buffer and process it normally. */
+        dynamic_macro_record_key(record);
     }
 
     return true;
 }
 
-#undef DYNAMIC_MACRO_CURRENT_SLOT
-#undef DYNAMIC_MACRO_CURRENT_LENGTH
-#undef DYNAMIC_MACRO_CURRENT_CAPACITY
-
 #endif
@@ -37,111 +37,197 @@ extern keymap_config_t keymap_config;
 
 #include <inttypes.h>
 
+/* How a keycode is turned into an action.
+ * Looked up from its high byte, or from its low byte for the basic keycodes,
+ * so decoding a key is a single table read instead of a walk over the
+ * keycode ranges.
+ */
+enum keycode_decode {
+    DECODE_NO = 0,
+    DECODE_TRANSPARENT,
+    DECODE_KEY,
+    DECODE_FN,
+    DECODE_SYSTEM,
+    DECODE_CONSUMER,
+    DECODE_MOUSEKEY,
+    DECODE_MODS,
+    DECODE_FUNCTION,
+    DECODE_MACRO,
+    DECODE_LAYER_TAP,
+    DECODE_TO,
+    DECODE_MOMENTARY,
+    DECODE_DEF_LAYER,
+    DECODE_TOGGLE_LAYER,
+    DECODE_ONE_SHOT_LAYER,
+    DECODE_ONE_SHOT_MOD,
+    DECODE_LAYER_TAP_TOGGLE,
+    DECODE_MOD_TAP,
+    DECODE_QUANTUM,
+};
+
+static const uint8_t basic_decode[0x100] PROGMEM = {
+    [KC_TRNS]                            = DECODE_TRANSPARENT,
+    [KC_A ... KC_EXSEL]                  = DECODE_KEY,
+    [KC_LCTRL ... KC_RGUI]               = DECODE_KEY,
+    [KC_FN0 ... KC_FN31]                 = DECODE_FN,
+    [KC_SYSTEM_POWER ... KC_SYSTEM_WAKE] = DECODE_SYSTEM,
+    [KC_AUDIO_MUTE ... KC_MEDIA_REWIND]  = DECODE_CONSUMER,
+    [KC_MS_UP ... KC_MS_ACCEL2]          = DECODE_MOUSEKEY,
+};
+
+/* indexed by the high byte, everything above QK_MOD_TAP_MAX is DECODE_NO */
+static const uint8_t quantum_decode[(QK_MOD_TAP_MAX >> 8) + 1] PROGMEM = {
+    [QK_MODS >> 8 ... QK_MODS_MAX >> 8]                         = DECODE_MODS,
+    [QK_FUNCTION >> 8 ... QK_FUNCTION_MAX >> 8]                 = DECODE_FUNCTION,
+    [QK_MACRO >> 8 ... QK_MACRO_MAX >> 8]                       = DECODE_MACRO,
+    [QK_LAYER_TAP >> 8 ... QK_LAYER_TAP_MAX >> 8]               = DECODE_LAYER_TAP,
+    [QK_TO >> 8]                                                = DECODE_TO,
+    [QK_MOMENTARY >> 8]                                         = DECODE_MOMENTARY,
+    [QK_DEF_LAYER >> 8]                                         = DECODE_DEF_LAYER,
+    [QK_TOGGLE_LAYER >> 8]                                      = DECODE_TOGGLE_LAYER,
+    [QK_ONE_SHOT_LAYER >> 8]                                    = DECODE_ONE_SHOT_LAYER,
+    [QK_ONE_SHOT_MOD >> 8]                                      = DECODE_ONE_SHOT_MOD,
+    [QK_LAYER_TAP_TOGGLE >> 8]                                  = DECODE_LAYER_TAP_TOGGLE,
+    [QK_MOD_TAP >> 8 ... QK_MOD_TAP_MAX >> 8]                   = DECODE_MOD_TAP,
+#ifdef BACKLIGHT_ENABLE
+    [BL_0 >> 8 ... BL_STEP >> 8]                                = DECODE_QUANTUM,
+#endif
+};
+
+static inline uint8_t keycode_decode(uint16_t keycode)
+{
+    if (keycode < 0x100) {
+        return pgm_read_byte(&basic_decode[keycode]);
+    }
+    if (keycode <= QK_MOD_TAP_MAX) {
+        return pgm_read_byte(&quantum_decode[keycode >> 8]);
+    }
+    return DECODE_NO;
+}
+
+/* The rare quantum keycodes that share their high byte with others */
+static action_t quantum_keycode_to_action(uint16_t keycode)
+{
+    action_t action;
+
+    switch (keycode) {
+    #ifdef BACKLIGHT_ENABLE
+        case BL_0 ... BL_15:
+            action.code = ACTION_BACKLIGHT_LEVEL(keycode - BL_0);
+            break;
+        case BL_DEC:
+            action.code = ACTION_BACKLIGHT_DECREASE();
+            break;
+        case BL_INC:
+            action.code = ACTION_BACKLIGHT_INCREASE();
+            break;
+        case BL_TOGG:
+            action.code = ACTION_BACKLIGHT_TOGGLE();
+            break;
+        case BL_STEP:
+            action.code = ACTION_BACKLIGHT_STEP();
+            break;
+    #endif
+        default:
+            action.code = ACTION_NO;
+            break;
+    }
+    return action;
+}
+
 /* converts key to action */
 action_t action_for_key(uint8_t layer, keypos_t key)
 {
     // 16bit keycodes - important
-    uint16_t keycode = keymap_key_to_keycode(layer, key);
+    return action_for_keycode(keymap_key_to_keycode(layer, key));
+}
 
+action_t action_for_keycode(uint16_t keycode)
+{
     // keycode remapping
     keycode = keycode_config(keycode);
 
     action_t action;
     uint8_t action_layer, when, mod;
 
-    switch (keycode) {
-        case KC_FN0 ... KC_FN31:
+    switch (keycode_decode(keycode)) {
+        case DECODE_FN:
             action.code = keymap_function_id_to_action(FN_INDEX(keycode));
             break;
-        case KC_A ... KC_EXSEL:
-        case KC_LCTRL ... KC_RGUI:
+        case DECODE_KEY:
             action.code = ACTION_KEY(keycode);
             break;
-        case KC_SYSTEM_POWER ... KC_SYSTEM_WAKE:
+        case DECODE_SYSTEM:
             action.code = ACTION_USAGE_SYSTEM(KEYCODE2SYSTEM(keycode));
             break;
-        case KC_AUDIO_MUTE ... KC_MEDIA_REWIND:
+        case DECODE_CONSUMER:
             action.code = ACTION_USAGE_CONSUMER(KEYCODE2CONSUMER(keycode));
             break;
-        case KC_MS_UP ... KC_MS_ACCEL2:
+        case DECODE_MOUSEKEY:
             action.code = ACTION_MOUSEKEY(keycode);
             break;
-        case KC_TRNS:
+        case DECODE_TRANSPARENT:
             action.code = ACTION_TRANSPARENT;
             break;
-        case QK_MODS ... QK_MODS_MAX: ;
+        case DECODE_MODS:
             // Has a modifier
             // Split it up
             action.code = ACTION_MODS_KEY(keycode >> 8, keycode & 0xFF); // adds modifier to key
             break;
-        case QK_FUNCTION ... QK_FUNCTION_MAX: ;
+        case DECODE_FUNCTION:
             // Is a shortcut for function action_layer, pull last 12bits
             // This means we have 4,096 FN macros at our disposal
             action.code = keymap_function_id_to_action( (int)keycode & 0xFFF );
             break;
-        case QK_MACRO ... QK_MACRO_MAX:
+        case DECODE_MACRO:
             if (keycode & 0x800) // tap macros have upper bit set
                 action.code = ACTION_MACRO_TAP(keycode & 0xFF);
             else
                 action.code = ACTION_MACRO(keycode & 0xFF);
             break;
-        case QK_LAYER_TAP ... QK_LAYER_TAP_MAX:
+        case DECODE_LAYER_TAP:
             action.code = ACTION_LAYER_TAP_KEY((keycode >> 0x8) & 0xF, keycode & 0xFF);
             break;
-        case QK_TO ... QK_TO_MAX: ;
+        case DECODE_TO:
             // Layer set "GOTO"
             when = (keycode >> 0x4) & 0x3;
             action_layer = keycode & 0xF;
             action.code = ACTION_LAYER_SET(action_layer, when);
             break;
-        case QK_MOMENTARY ... QK_MOMENTARY_MAX: ;
+        case DECODE_MOMENTARY:
             // Momentary action_layer
             action_layer = keycode & 0xFF;
             action.code = ACTION_LAYER_MOMENTARY(action_layer);
             break;
-        case QK_DEF_LAYER ... QK_DEF_LAYER_MAX: ;
+        case DECODE_DEF_LAYER:
             // Set default action_layer
             action_layer = keycode & 0xFF;
             action.code = ACTION_DEFAULT_LAYER_SET(action_layer);
             break;
-        case QK_TOGGLE_LAYER ... QK_TOGGLE_LAYER_MAX: ;
+        case DECODE_TOGGLE_LAYER:
             // Set toggle
             action_layer = keycode & 0xFF;
             action.code = ACTION_LAYER_TOGGLE(action_layer);
             break;
-        case QK_ONE_SHOT_LAYER ... QK_ONE_SHOT_LAYER_MAX: ;
+        case DECODE_ONE_SHOT_LAYER:
             // OSL(action_layer) - One-shot action_layer
             action_layer = keycode & 0xFF;
             action.code = ACTION_LAYER_ONESHOT(action_layer);
             break;
-        case QK_ONE_SHOT_MOD ... QK_ONE_SHOT_MOD_MAX: ;
+        case DECODE_ONE_SHOT_MOD:
             // OSM(mod) - One-shot mod
             mod = keycode & 0xFF;
             action.code = ACTION_MODS_ONESHOT(mod);
             break;
-        case QK_LAYER_TAP_TOGGLE ... QK_LAYER_TAP_TOGGLE_MAX:
+        case DECODE_LAYER_TAP_TOGGLE:
             action.code = ACTION_LAYER_TAP_TOGGLE(keycode & 0xFF);
             break;
-        case QK_MOD_TAP ... QK_MOD_TAP_MAX:
+        case DECODE_MOD_TAP:
             action.code = ACTION_MODS_TAP_KEY((keycode >> 0x8) & 0x1F, keycode & 0xFF);
             break;
-    #ifdef BACKLIGHT_ENABLE
-        case BL_0 ... BL_15:
-            action.code = ACTION_BACKLIGHT_LEVEL(keycode - BL_0);
-            break;
-        case BL_DEC:
-            action.code = ACTION_BACKLIGHT_DECREASE();
-            break;
-        case BL_INC:
-            action.code = ACTION_BACKLIGHT_INCREASE();
+        case DECODE_QUANTUM:
+            action = quantum_keycode_to_action(keycode);
             break;
-        case BL_TOGG:
-            action.code = ACTION_BACKLIGHT_TOGGLE();
-            break;
-        case BL_STEP:
-            action.code = ACTION_BACKLIGHT_STEP();
-            break;
-    #endif
         default:
             action.code = ACTION_NO;
             break;
@@ -8,4 +8,6 @@ void process_audio_all_notes_off(void);
 
 void audio_on_user(void);
 
+#define PROCESS_AUDIO_KEYCODES(p) { AU_ON, AU_TOG, p }, { MUV_IN, MUV_DE, p },
+
 #endif
\ No newline at end of file
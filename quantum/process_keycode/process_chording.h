@@ -29,4 +29,6 @@ uint8_t chord_key_down = 0;
 
 bool process_chording(uint16_t keycode, keyrecord_t *record);
 
+#define PROCESS_CHORDING_KEYCODES(p) { QK_CHORDING, QK_CHORDING_MAX, p },
+
 #endif
@@ -16,13 +16,14 @@
 
 #include "process_combo.h"
 #include "print.h"
+#include "deferred_exec.h"
 
 
-#define COMBO_TIMER_ELAPSED -1
+#define COMBO_NONE 0xFF
 
 
 __attribute__ ((weak))
-combo_t key_combos[] = {
+combo_t key_combos[COMBO_COUNT] = {
 
 };
 
@@ -31,10 +32,158 @@ void process_combo_event(uint8_t combo_index, bool pressed) {
 
 }
 
-static uint8_t current_combo_index = 0;
+/* Inverted index from keycode to the combos containing it, sorted by
+ * keycode and then by combo, built the first time combos are used. Each
+ * entry points at a key of a combo, so that the keycode itself stays in
+ * the combo's key list. The combos from combo_indexed on did not fit and
+ * are found by scanning their key lists instead. */
+typedef struct {
+    uint8_t combo;
+    uint8_t key;
+} combo_index_t;
 
-static inline void send_combo(uint16_t action, bool pressed)
+static combo_index_t combo_index[COMBO_INDEX_SIZE];
+static uint16_t combo_index_size = 0;
+static uint8_t combo_indexed = 0;
+static bool combo_index_ready = false;
+
+static inline uint16_t combo_index_keycode(uint16_t i)
+{
+    return pgm_read_word(&key_combos[combo_index[i].combo].keys[combo_index[i].key]);
+}
+
+/* Number of different keys in each combo, 0 if the combo is disabled */
+static uint8_t combo_length[COMBO_COUNT];
+
+/* Combo keys pressed since the first of them, waiting to be resolved into
+ * the longest combo they make or to be replayed as normal keys. */
+static keyrecord_t combo_buffer[COMBO_KEY_BUFFER_LENGTH];
+static uint8_t combo_buffer_count = 0;
+/* Resolves the buffered keys once COMBO_TERM has passed */
+static deferred_token combo_buffer_timeout = INVALID_DEFERRED_TOKEN;
+
+/* Number of buffered keys in each combo */
+static uint8_t combo_matched[COMBO_COUNT];
+
+/* Keys of the combos that have been sent, until they are released */
+typedef struct {
+    keypos_t key;
+    uint8_t combo;
+} combo_held_t;
+
+static combo_held_t combo_held[COMBO_HELD_KEYS_LENGTH];
+static uint8_t combo_held_count = 0;
+
+/* Combos whose keycode is pressed */
+static uint8_t combo_active[(COMBO_COUNT + 7) / 8];
+
+#define COMBO_IS_ACTIVE(i)      (combo_active[(i) / 8] & (1 << ((i) % 8)))
+#define COMBO_ACTIVATE(i)       do{ combo_active[(i) / 8] |= (1 << ((i) % 8)); } while(0)
+#define COMBO_DEACTIVATE(i)     do{ combo_active[(i) / 8] &= ~(1 << ((i) % 8)); } while(0)
+
+/* Whether the keycode is among the first count keys of the combo */
+static bool combo_contains(uint8_t combo, uint16_t keycode, uint8_t count)
+{
+    for (uint8_t k = 0; k < count; ++k) {
+        uint16_t key = pgm_read_word(&key_combos[combo].keys[k]);
+        if (key == COMBO_END) break;
+        if (key == keycode) return true;
+    }
+    return false;
+}
+
+static void combo_index_init(void)
+{
+    for (uint8_t c = 0; c < COMBO_COUNT; ++c) {
+        uint8_t length = 0;
+        uint8_t count = 0;
+        for (uint16_t key; COMBO_END != (key = pgm_read_word(&key_combos[c].keys[count])); ++count) {
+            /* A key listed twice in one combo is only counted once */
+            if (combo_contains(c, key, count)) continue;
+
+            if (length == COMBO_KEY_BUFFER_LENGTH) {
+                /* Never sent, so it is reported even without debug */
+                xprintf("combo: combo %d has more than %d keys, raise COMBO_KEY_BUFFER_LENGTH\n",
+                        c, COMBO_KEY_BUFFER_LENGTH);
+                length = 0;
+                break;
+            }
+            length++;
+        }
+        combo_length[c] = length;
+
+        if (combo_indexed != c) continue;
+        if (combo_index_size + length > COMBO_INDEX_SIZE) {
+            dprintf("combo: combos from %d on are scanned, raise COMBO_INDEX_SIZE\n", c);
+            continue;
+        }
+        for (uint8_t k = 0; k < count && length; ++k) {
+            if (!combo_contains(c, pgm_read_word(&key_combos[c].keys[k]), k)) {
+                combo_index[combo_index_size++] = (combo_index_t){ c, k };
+            }
+        }
+        combo_indexed = c + 1;
+    }
+
+    /* Insertion sort keeps the combos of each keycode in order */
+    for (uint16_t i = 1; i < combo_index_size; ++i) {
+        combo_index_t entry = combo_index[i];
+        uint16_t keycode = pgm_read_word(&key_combos[entry.combo].keys[entry.key]);
+        uint16_t j = i;
+        for (; j > 0 && combo_index_keycode(j - 1) > keycode; --j) {
+            combo_index[j] = combo_index[j - 1];
+        }
+        combo_index[j] = entry;
+    }
+    combo_index_ready = true;
+}
+
+/* First index entry with the given keycode, or combo_index_size */
+static uint16_t combo_index_find(uint16_t keycode)
+{
+    uint16_t lo = 0;
+    uint16_t hi = combo_index_size;
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        if (combo_index_keycode(mid) < keycode) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Walks the combos containing a keycode, first through the index and then
+ * through the key lists of the combos left out of it */
+typedef struct {
+    uint16_t next;
+    bool scanning;
+} combo_iter_t;
+
+static uint8_t combo_iter_next(combo_iter_t *iter, uint16_t keycode)
+{
+    if (!iter->scanning) {
+        if (iter->next < combo_index_size && combo_index_keycode(iter->next) == keycode) {
+            return combo_index[iter->next++].combo;
+        }
+        iter->scanning = true;
+        iter->next = combo_indexed;
+    }
+    while (iter->next < COMBO_COUNT) {
+        uint8_t c = iter->next++;
+        if (combo_length[c] && combo_contains(c, keycode, 0xFF)) return c;
+    }
+    return COMBO_NONE;
+}
+
+#define FOREACH_COMBO_OF(c, kc) \
+    for (combo_iter_t c##_iter = { combo_index_find(kc), false }; \
+         ((c) = combo_iter_next(&c##_iter, (kc))) != COMBO_NONE;)
+
+static inline void send_combo(uint8_t combo, bool pressed)
 {
+    uint16_t action = key_combos[combo].keycode;
     if (action) {
         if (pressed) {
             register_code16(action);
@@ -42,109 +191,146 @@ static inline void send_combo(uint16_t action, bool pressed)
             unregister_code16(action);
         }
     } else {
-        process_combo_event(current_combo_index, pressed);
+        process_combo_event(combo, pressed);
     }
 }
 
-#define ALL_COMBO_KEYS_ARE_DOWN     (((1<<count)-1) == combo->state)
-#define NO_COMBO_KEYS_ARE_DOWN      (0 == combo->state)
-#define KEY_STATE_DOWN(key)         do{ combo->state |= (1<<key); } while(0)
-#define KEY_STATE_UP(key)           do{ combo->state &= ~(1<<key); } while(0)
-static bool process_single_combo(combo_t *combo, uint16_t keycode, keyrecord_t *record) 
+/* Hands a buffered key press on as if no combo had been waiting for it */
+static void combo_replay(keyrecord_t *record)
 {
-    uint8_t count = 0;
-    uint8_t index = -1;
-    /* Find index of keycode and number of combo keys */
-    for (const uint16_t *keys = combo->keys; ;++count) {
-        uint16_t key = pgm_read_word(&keys[count]);
-        if (keycode == key) index = count;
-        if (COMBO_END == key) break;
-    }
-
-    /* Return if not a combo key */
-    if (-1 == (int8_t)index) return false;
-
-    /* The combos timer is used to signal whether the combo is active */
-    bool is_combo_active = COMBO_TIMER_ELAPSED == combo->timer ? false : true;
-
-    if (record->event.pressed) {
-        KEY_STATE_DOWN(index);
-
-        if (is_combo_active) {
-            if (ALL_COMBO_KEYS_ARE_DOWN) { /* Combo was pressed */
-                send_combo(combo->keycode, true);
-                combo->timer = COMBO_TIMER_ELAPSED;
-            } else { /* Combo key was pressed */
-                combo->timer = timer_read();
 #ifdef COMBO_ALLOW_ACTION_KEYS
-                combo->prev_record = *record;
+    process_action(record, store_or_get_action(record->event.pressed, record->event.key));
 #else
-                combo->prev_key = keycode;
+    register_code16(record->keycode);
 #endif
+}
+
+/* Sends the longest combo made of buffered keys, or the first one listed
+ * of those equally long, and replays the other keys. Everything goes out
+ * in the order the keys were pressed, the combo at its last key. */
+static void combo_resolve(void)
+{
+    uint8_t best = COMBO_NONE;
+    uint8_t c;
+    for (uint8_t b = 0; b < combo_buffer_count; ++b) {
+        FOREACH_COMBO_OF(c, combo_buffer[b].keycode) {
+            if (combo_matched[c] != combo_length[c]) continue;
+            if (best == COMBO_NONE || combo_length[c] > combo_length[best] ||
+                (combo_length[c] == combo_length[best] && c < best)) {
+                best = c;
             }
         }
-    } else {
-        if (ALL_COMBO_KEYS_ARE_DOWN) { /* Combo was released */
-            send_combo(combo->keycode, false);
-        }
+    }
+    if (best != COMBO_NONE && combo_held_count + combo_length[best] > COMBO_HELD_KEYS_LENGTH) {
+        dprintf("combo: too many keys held, combo %d not sent\n", best);
+        best = COMBO_NONE;
+    }
 
-        if (is_combo_active) { /* Combo key was tapped */
-#ifdef COMBO_ALLOW_ACTION_KEYS
-            record->event.pressed = true;
-            process_action(record, store_or_get_action(record->event.pressed, record->event.key));
-            record->event.pressed = false;
-            process_action(record, store_or_get_action(record->event.pressed, record->event.key));
-#else
-            register_code16(keycode);
-            send_keyboard_report();
-            unregister_code16(keycode);
-#endif
-            combo->timer = 0;            
+    uint8_t remaining = best == COMBO_NONE ? 0 : combo_length[best];
+    for (uint8_t b = 0; b < combo_buffer_count; ++b) {
+        keyrecord_t *record = &combo_buffer[b];
+        FOREACH_COMBO_OF(c, record->keycode) {
+            combo_matched[c]--;
+        }
+        if (remaining && combo_contains(best, record->keycode, 0xFF)) {
+            combo_held[combo_held_count++] = (combo_held_t){ record->event.key, best };
+            if (--remaining == 0) {
+                COMBO_ACTIVATE(best);
+                send_combo(best, true);
+            }
+        } else {
+            combo_replay(record);
         }
-
-        KEY_STATE_UP(index);        
     }
+    combo_buffer_count = 0;
+    cancel_deferred_exec(combo_buffer_timeout);
+    combo_buffer_timeout = INVALID_DEFERRED_TOKEN;
+}
 
-    if (NO_COMBO_KEYS_ARE_DOWN) {
-        combo->timer = 0;
+static uint32_t combo_buffer_expired(uint32_t trigger_time, void *cb_arg)
+{
+    /* Whatever the keys make by now is sent, the other keys are
+     * handled by the next processors in the chain
+     */
+    combo_resolve();
+    return 0;
+}
+
+/* Whether the pressed key can still be part of one combo with the
+ * buffered keys */
+static bool combo_buffer_accepts(uint16_t keycode)
+{
+    for (uint8_t b = 0; b < combo_buffer_count; ++b) {
+        if (combo_buffer[b].keycode == keycode) return false;
     }
+    uint8_t c;
+    FOREACH_COMBO_OF(c, keycode) {
+        if (combo_matched[c] == combo_buffer_count) return true;
+    }
+    return false;
+}
 
-    return is_combo_active;
+/* Releases the combo the key was part of, and swallows the key */
+static bool combo_release(keypos_t key)
+{
+    for (uint8_t i = 0; i < combo_held_count; ++i) {
+        if (KEYEQ(combo_held[i].key, key)) {
+            uint8_t c = combo_held[i].combo;
+            combo_held[i] = combo_held[--combo_held_count];
+            if (COMBO_IS_ACTIVE(c)) { /* Combo was released */
+                COMBO_DEACTIVATE(c);
+                send_combo(c, false);
+            }
+            return false;
+        }
+    }
+    return true;
 }
 
 bool process_combo(uint16_t keycode, keyrecord_t *record)
 {
-    bool is_combo_key = false;
+    if (!combo_index_ready) {
+        combo_index_init();
+    }
 
-    for (current_combo_index = 0; current_combo_index < COMBO_COUNT; ++current_combo_index) {
-        combo_t *combo = &key_combos[current_combo_index];
-        is_combo_key |= process_single_combo(combo, keycode, record);
-    }    
+    if (!record->event.pressed) {
+        /* Any release ends the wait, so that nothing is reordered */
+        if (combo_buffer_count) {
+            combo_resolve();
+        }
+        return combo_release(record->event.key);
+    }
 
-    return !is_combo_key;
-}
+    combo_iter_t iter = { combo_index_find(keycode), false };
+    bool is_combo_key = combo_iter_next(&iter, keycode) != COMBO_NONE;
 
-void matrix_scan_combo(void)
-{
-    for (int i = 0; i < COMBO_COUNT; ++i) {
-        combo_t *combo = &key_combos[i];
-        if (combo->timer && 
-            combo->timer != COMBO_TIMER_ELAPSED && 
-            timer_elapsed(combo->timer) > COMBO_TERM) {
-            
-            /* This disables the combo, meaning key events for this
-             * combo will be handled by the next processors in the chain 
-             */
-            combo->timer = COMBO_TIMER_ELAPSED;
+    if (combo_buffer_count && !(is_combo_key && combo_buffer_accepts(keycode))) {
+        combo_resolve();
+    }
+    if (!is_combo_key) {
+        return true;
+    }
 
-#ifdef COMBO_ALLOW_ACTION_KEYS
-            process_action(&combo->prev_record, 
-                store_or_get_action(combo->prev_record.event.pressed, 
-                                    combo->prev_record.event.key));
-#else
-            unregister_code16(combo->prev_key);
-            register_code16(combo->prev_key);
-#endif
+    if (!combo_buffer_count) {
+        combo_buffer_timeout = defer_exec(COMBO_TERM + 1, combo_buffer_expired, NULL);
+        if (combo_buffer_timeout == INVALID_DEFERRED_TOKEN) {
+            /* Nothing would end the wait, so the key is not held back */
+            dprintf("combo: no deferred task left, raise DEFERRED_EXEC_TASKS\n");
+            return true;
         }
     }
+    combo_buffer[combo_buffer_count++] = *record;
+
+    /* Wait as long as a longer combo could still be completed */
+    bool is_pending = false;
+    uint8_t c;
+    FOREACH_COMBO_OF(c, keycode) {
+        if (++combo_matched[c] == combo_buffer_count && combo_length[c] > combo_buffer_count) {
+            is_pending = true;
+        }
+    }
+    if (!is_pending) {
+        combo_resolve();
+    }
+    return false;
 }
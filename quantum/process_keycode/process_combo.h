@@ -25,19 +25,6 @@ typedef struct
 {
     const uint16_t *keys;
     uint16_t keycode;        
-#ifdef EXTRA_EXTRA_LONG_COMBOS
-    uint32_t state;
-#elif EXTRA_LONG_COMBOS
-    uint16_t state;
-#else
-    uint8_t state;
-#endif
-    uint16_t timer;
-#ifdef COMBO_ALLOW_ACTION_KEYS
-    keyrecord_t prev_record;
-#else
-    uint16_t prev_key;
-#endif
 } combo_t;
 
 
@@ -51,9 +38,34 @@ typedef struct
 #ifndef COMBO_TERM
 #define COMBO_TERM TAPPING_TERM
 #endif
+/* Most keys waiting to be resolved, which is also the longest combo.
+ * Longer combos are disabled at startup with a message on the console. */
+#ifndef COMBO_KEY_BUFFER_LENGTH
+#  if defined(EXTRA_EXTRA_LONG_COMBOS)
+#    define COMBO_KEY_BUFFER_LENGTH 32
+#  elif defined(EXTRA_LONG_COMBOS)
+#    define COMBO_KEY_BUFFER_LENGTH 16
+#  else
+#    define COMBO_KEY_BUFFER_LENGTH 8
+#  endif
+#endif
+/* Total number of keys over all combos that the keycode index can hold,
+ * two bytes of RAM each. By default there is room for combos of four keys
+ * on average, up to 128 keys; the combos that do not fit are still found,
+ * by scanning their key lists on every key press. */
+#ifndef COMBO_INDEX_SIZE
+#define COMBO_INDEX_SIZE (COMBO_COUNT * 4 < 128 ? COMBO_COUNT * 4 : 128)
+#endif
+/* Most keys held down by combos that have been sent */
+#ifndef COMBO_HELD_KEYS_LENGTH
+#define COMBO_HELD_KEYS_LENGTH (COMBO_KEY_BUFFER_LENGTH * 2)
+#endif
 
 bool process_combo(uint16_t keycode, keyrecord_t *record);
-void matrix_scan_combo(void);
+
+// Any keycode can be part of a combo
+#define PROCESS_COMBO_KEYCODES(p) { 0x0000, 0xFFFF, p },
+
 void process_combo_event(uint8_t combo_index, bool pressed);
 
 #endif
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include "process_leader.h"
 
 __attribute__ ((weak))
@@ -22,13 +23,95 @@ void leader_start(void) {}
 __attribute__ ((weak))
 void leader_end(void) {}
 
+__attribute__ ((weak))
+void process_leader_event(uint8_t index) {}
+
 // Leader key stuff
 bool leading = false;
 uint16_t leader_time = 0;
 
-uint16_t leader_sequence[5] = {0, 0, 0, 0, 0};
+uint16_t leader_sequence[LEADER_MAX_LENGTH] = {0};
 uint8_t leader_sequence_size = 0;
 
+#if LEADER_DICTIONARY_SIZE > 0
+/* The dictionary in lexicographic order of the sequences, so that the
+ * sequences starting with the keys typed so far are the range
+ * [leader_first, leader_last) of it, like a node of a trie. Shorter
+ * sequences come first, as the unused keys are 0. */
+static uint8_t leader_order[LEADER_DICTIONARY_SIZE];
+static bool leader_order_ready = false;
+static uint8_t leader_first = 0;
+static uint8_t leader_last = 0;
+
+#define LEADER_KEY(i, depth) pgm_read_word(&leader_dictionary[leader_order[i]].keys[depth])
+
+static bool leader_seq_less(uint8_t a, uint8_t b) {
+  for (uint8_t d = 0; d < LEADER_MAX_LENGTH; d++) {
+    uint16_t key_a = pgm_read_word(&leader_dictionary[a].keys[d]);
+    uint16_t key_b = pgm_read_word(&leader_dictionary[b].keys[d]);
+    if (key_a != key_b) {
+      return key_a < key_b;
+    }
+  }
+  return false;
+}
+
+static void leader_order_init(void) {
+  for (uint8_t i = 0; i < LEADER_DICTIONARY_SIZE; i++) {
+    uint8_t j = i;
+    for (; j > 0 && leader_seq_less(i, leader_order[j - 1]); j--) {
+      leader_order[j] = leader_order[j - 1];
+    }
+    leader_order[j] = i;
+  }
+  leader_order_ready = true;
+}
+
+/* First sequence in [first, last) whose key at depth is not below key,
+ * or with above set, above key */
+static uint8_t leader_search(uint8_t first, uint8_t last, uint8_t depth, uint16_t key, bool above) {
+  while (first < last) {
+    uint8_t mid = first + (last - first) / 2;
+    uint16_t mid_key = LEADER_KEY(mid, depth);
+    if (mid_key < key || (above && mid_key == key)) {
+      first = mid + 1;
+    } else {
+      last = mid;
+    }
+  }
+  return first;
+}
+
+/* The sequence that is exactly the keys typed so far, if any */
+static bool leader_exact_match(uint8_t *index) {
+  if (leader_first == leader_last || leader_sequence_size == 0) {
+    return false;
+  }
+  if (leader_sequence_size < LEADER_MAX_LENGTH && LEADER_KEY(leader_first, leader_sequence_size) != 0) {
+    return false;
+  }
+  *index = leader_order[leader_first];
+  return true;
+}
+
+static void leader_send(uint8_t index) {
+  leading = false;
+  leader_end();
+
+  uint16_t keycode = pgm_read_word(&leader_dictionary[index].keycode);
+  if (keycode) {
+    register_code16(keycode);
+    unregister_code16(keycode);
+  } else {
+    process_leader_event(index);
+  }
+}
+#endif
+
+bool process_leader_sees_all_keys(void) {
+  return leading;
+}
+
 bool process_leader(uint16_t keycode, keyrecord_t *record) {
   // Leader key set-up
   if (record->event.pressed) {
@@ -37,18 +120,54 @@ bool process_leader(uint16_t keycode, keyrecord_t *record) {
       leading = true;
       leader_time = timer_read();
       leader_sequence_size = 0;
-      leader_sequence[0] = 0;
-      leader_sequence[1] = 0;
-      leader_sequence[2] = 0;
-      leader_sequence[3] = 0;
-      leader_sequence[4] = 0;
+      memset(leader_sequence, 0, sizeof(leader_sequence));
+#if LEADER_DICTIONARY_SIZE > 0
+      if (!leader_order_ready) {
+        leader_order_init();
+      }
+      leader_first = 0;
+      leader_last = LEADER_DICTIONARY_SIZE;
+#endif
       return false;
     }
     if (leading && timer_elapsed(leader_time) < LEADER_TIMEOUT) {
+      if (leader_sequence_size == LEADER_MAX_LENGTH) {
+        return false;
+      }
       leader_sequence[leader_sequence_size] = keycode;
       leader_sequence_size++;
+
+#if LEADER_DICTIONARY_SIZE > 0
+      // Narrow the range down to the sequences continuing with this key
+      uint8_t depth = leader_sequence_size - 1;
+      leader_first = leader_search(leader_first, leader_last, depth, keycode, false);
+      leader_last = leader_search(leader_first, leader_last, depth, keycode, true);
+
+      // No other sequence can still match, so there is no need to wait
+      uint8_t index;
+      if (leader_last - leader_first == 1 && leader_exact_match(&index)) {
+        leader_send(index);
+      }
+#endif
       return false;
     }
   }
   return true;
 }
+
+void matrix_scan_leader(void) {
+#if LEADER_DICTIONARY_SIZE > 0
+  // Sequences written out with SEQ_ONE_KEY() and friends end leading
+  // themselves in matrix_scan_user(), which has run by now
+  if (!leading || timer_elapsed(leader_time) <= LEADER_TIMEOUT) {
+    return;
+  }
+  uint8_t index;
+  if (leader_exact_match(&index)) {
+    leader_send(index);
+  } else {
+    leading = false;
+    leader_end();
+  }
+#endif
+}
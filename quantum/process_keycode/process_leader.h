@@ -20,6 +20,9 @@
 #include "quantum.h"
 
 bool process_leader(uint16_t keycode, keyrecord_t *record);
+bool process_leader_sees_all_keys(void);
+
+#define PROCESS_LEADER_KEYCODES(p) { KC_LEAD, KC_LEAD, p },
 
 void leader_start(void);
 void leader_end(void);
@@ -27,13 +30,37 @@ void leader_end(void);
 #ifndef LEADER_TIMEOUT
   #define LEADER_TIMEOUT 200
 #endif
-#define SEQ_ONE_KEY(key) if (leader_sequence[0] == (key) && leader_sequence[1] == 0 && leader_sequence[2] == 0 && leader_sequence[3] == 0 && leader_sequence[4] == 0)
-#define SEQ_TWO_KEYS(key1, key2) if (leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == 0 && leader_sequence[3] == 0 && leader_sequence[4] == 0)
-#define SEQ_THREE_KEYS(key1, key2, key3) if (leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == (key3) && leader_sequence[3] == 0 && leader_sequence[4] == 0)
-#define SEQ_FOUR_KEYS(key1, key2, key3, key4) if (leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == (key3) && leader_sequence[3] == (key4) && leader_sequence[4] == 0)
-#define SEQ_FIVE_KEYS(key1, key2, key3, key4, key5) if (leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == (key3) && leader_sequence[3] == (key4) && leader_sequence[4] == (key5))
+/* Most keys in a sequence after the leader */
+#ifndef LEADER_MAX_LENGTH
+  #define LEADER_MAX_LENGTH 5
+#endif
+#ifndef LEADER_DICTIONARY_SIZE
+  #define LEADER_DICTIONARY_SIZE 0
+#endif
+
+/* A sequence of the leader dictionary, sends keycode or, if it is 0, calls
+ * process_leader_event() with the index of the sequence */
+typedef struct {
+  uint16_t keys[LEADER_MAX_LENGTH];
+  uint16_t keycode;
+} leader_seq_t;
+
+#define LEADER_SEQ(kc, ...)       {.keys = { __VA_ARGS__ }, .keycode = (kc)}
+#define LEADER_SEQ_ACTION(...)    {.keys = { __VA_ARGS__ }}
+
+/* Defined in the keymap, with LEADER_DICTIONARY_SIZE sequences */
+extern const leader_seq_t leader_dictionary[];
+
+void matrix_scan_leader(void);
+void process_leader_event(uint8_t index);
+
+#define SEQ_ONE_KEY(key) if (leader_sequence_size == 1 && leader_sequence[0] == (key))
+#define SEQ_TWO_KEYS(key1, key2) if (leader_sequence_size == 2 && leader_sequence[0] == (key1) && leader_sequence[1] == (key2))
+#define SEQ_THREE_KEYS(key1, key2, key3) if (leader_sequence_size == 3 && leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == (key3))
+#define SEQ_FOUR_KEYS(key1, key2, key3, key4) if (leader_sequence_size == 4 && leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == (key3) && leader_sequence[3] == (key4))
+#define SEQ_FIVE_KEYS(key1, key2, key3, key4, key5) if (leader_sequence_size == 5 && leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == (key3) && leader_sequence[3] == (key4) && leader_sequence[4] == (key5))
 
-#define LEADER_EXTERNS() extern bool leading; extern uint16_t leader_time; extern uint16_t leader_sequence[5]; extern uint8_t leader_sequence_size
+#define LEADER_EXTERNS() extern bool leading; extern uint16_t leader_time; extern uint16_t leader_sequence[LEADER_MAX_LENGTH]; extern uint8_t leader_sequence_size
 #define LEADER_DICTIONARY() if (leading && timer_elapsed(leader_time) > LEADER_TIMEOUT)
 
 #endif
@@ -45,6 +45,8 @@ void midi_init(void);
 void midi_task(void);
 bool process_midi(uint16_t keycode, keyrecord_t *record);
 
+#define PROCESS_MIDI_KEYCODES(p) { MIDI_TONE_MIN, MI_MODSU, p },
+
 #define MIDI_INVALID_NOTE 0xFF
 #define MIDI_TONE_COUNT (MIDI_TONE_MAX - MIDI_TONE_MIN + 1)
 
@@ -23,6 +23,9 @@
 
 bool process_music(uint16_t keycode, keyrecord_t *record);
 
+// Music mode plays every key, see is_music_on()
+#define PROCESS_MUSIC_KEYCODES(p) { MU_ON, MU_TOG, p },
+
 bool is_music_on(void);
 void music_toggle(void);
 void music_on(void);
@@ -74,6 +74,10 @@ void print_box_string(const char text[]) {
 	print_string(out); 
 }
 
+bool process_printer_sees_all_keys(void) {
+	return printing_enabled;
+}
+
 bool process_printer(uint16_t keycode, keyrecord_t *record) {
 	if (keycode == PRINT_ON) {
 		enable_printing();
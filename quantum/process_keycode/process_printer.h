@@ -22,5 +22,8 @@
 #include "protocol/serial.h"
 
 bool process_printer(uint16_t keycode, keyrecord_t *record);
+bool process_printer_sees_all_keys(void);
+
+#define PROCESS_PRINTER_KEYCODES(p) { PRINT_ON, PRINT_OFF, p },
 
 #endif
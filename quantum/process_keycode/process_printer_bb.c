@@ -80,6 +80,10 @@ void print_string(char c[]) {
 		print_char(c[i]);
 }
 
+bool process_printer_sees_all_keys(void) {
+	return printing_enabled;
+}
+
 bool process_printer(uint16_t keycode, keyrecord_t *record) {
 	if (keycode == PRINT_ON) {
 		enable_printing();
@@ -13,13 +13,47 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <string.h>
 #include "quantum.h"
 #include "action_tapping.h"
+#include "deferred_exec.h"
 
 uint8_t get_oneshot_mods(void);
 
 static uint16_t last_td;
-static int8_t highest_td = -1;
+/* Indexes of the dances that are going on, oldest first */
+static uint8_t active_td[TAP_DANCE_MAX_ACTIVE];
+static uint8_t active_td_count = 0;
+/* Finishes the dances whose term has passed */
+static deferred_token tap_dance_timeout = INVALID_DEFERRED_TOKEN;
+
+static bool tap_dance_activate (uint8_t idx) {
+  for (uint8_t i = 0; i < active_td_count; i++) {
+    if (active_td[i] == idx)
+      return true;
+  }
+  if (active_td_count == TAP_DANCE_MAX_ACTIVE)
+    return false;
+  active_td[active_td_count++] = idx;
+  return true;
+}
+
+static void tap_dance_deactivate (uint8_t idx) {
+  for (uint8_t i = 0; i < active_td_count; i++) {
+    if (active_td[i] == idx) {
+      active_td_count--;
+      for (; i < active_td_count; i++)
+        active_td[i] = active_td[i + 1];
+      return;
+    }
+  }
+}
+
+/* Copies the active dances, as finishing one can change the list */
+static uint8_t tap_dance_get_active (uint8_t *dances) {
+  memcpy (dances, active_td, active_td_count);
+  return active_td_count;
+}
 
 void qk_tap_dance_pair_finished (qk_tap_dance_state_t *state, void *user_data) {
   qk_tap_dance_pair_t *pair = (qk_tap_dance_pair_t *)user_data;
@@ -72,6 +106,60 @@ static inline void process_tap_dance_action_on_reset (qk_tap_dance_action_t *act
   send_keyboard_report();
 }
 
+static uint16_t tap_dance_term (qk_tap_dance_action_t *action) {
+  return action->custom_tapping_term > 0 ? action->custom_tapping_term : TAPPING_TERM;
+}
+
+/* ms until the next dance that is going on times out, 0 if none is.
+ * A finished dance that is still held waits for its release instead. */
+static uint32_t tap_dance_next (void) {
+  uint32_t next = 0;
+  for (uint8_t i = 0; i < active_td_count; i++) {
+    qk_tap_dance_action_t *action = &tap_dance_actions[active_td[i]];
+    if (action->state.finished)
+      continue;
+    uint16_t elapsed = timer_elapsed (action->state.timer);
+    uint16_t term = tap_dance_term (action);
+    uint32_t left = elapsed > term ? 1 : term + 1 - elapsed;
+    if (!next || left < next)
+      next = left;
+  }
+  return next;
+}
+
+static uint32_t tap_dance_expired (uint32_t trigger_time, void *cb_arg) {
+  uint8_t dances[TAP_DANCE_MAX_ACTIVE];
+  uint8_t count = tap_dance_get_active (dances);
+  for (uint8_t i = 0; i < count; i++) {
+    qk_tap_dance_action_t *action = &tap_dance_actions[dances[i]];
+    if (action->state.count && timer_elapsed (action->state.timer) > tap_dance_term (action)) {
+      process_tap_dance_action_on_dance_finished (action);
+      reset_tap_dance (&action->state);
+    }
+  }
+  uint32_t next = tap_dance_next ();
+  if (!next) {
+    tap_dance_timeout = INVALID_DEFERRED_TOKEN;
+    return 0;
+  }
+  return timer_read32 () - trigger_time + next;
+}
+
+/* Makes sure tap_dance_expired runs when the next dance times out, false
+ * if no deferred task was left for it */
+static bool tap_dance_schedule (void) {
+  uint32_t next = tap_dance_next ();
+  if (!extend_deferred_exec (tap_dance_timeout, next)) {
+    tap_dance_timeout = defer_exec (next, tap_dance_expired, NULL);
+  }
+  return tap_dance_timeout != INVALID_DEFERRED_TOKEN;
+}
+
+// While a dance is going on every key can interrupt it
+bool process_tap_dance_sees_all_keys(void) {
+  return active_td_count != 0;
+}
+
 bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
   uint16_t idx = keycode - QK_TAP_DANCE;
   qk_tap_dance_action_t *action;
@@ -82,10 +170,13 @@ bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
 
   switch(keycode) {
   case QK_TAP_DANCE ... QK_TAP_DANCE_MAX:
-    if ((int16_t)idx > highest_td)
-      highest_td = idx;
     action = &tap_dance_actions[idx];
 
+    if (record->event.pressed && !tap_dance_activate (idx)) {
+      dprintf("tap dance: more than %d dances going on\n", TAP_DANCE_MAX_ACTIVE);
+      break;
+    }
+
     action->state.pressed = record->event.pressed;
     if (record->event.pressed) {
       action->state.keycode = keycode;
@@ -102,6 +193,14 @@ bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
       }
 
       last_td = keycode;
+      if (!tap_dance_schedule ()) {
+        /* Nothing would time the dance out, so it ends with this tap */
+        dprintf("tap dance: no deferred task left, raise DEFERRED_EXEC_TASKS\n");
+        process_tap_dance_action_on_dance_finished (action);
+      }
+    } else if (action->state.finished) {
+      /* Its release is all a finished dance was waiting for */
+      reset_tap_dance (&action->state);
     }
 
     break;
@@ -110,11 +209,13 @@ bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
     if (!record->event.pressed)
       return true;
 
-    if (highest_td == -1)
+    if (active_td_count == 0)
       return true;
 
-    for (int i = 0; i <= highest_td; i++) {
-      action = &tap_dance_actions[i];
+    uint8_t dances[TAP_DANCE_MAX_ACTIVE];
+    uint8_t count = tap_dance_get_active (dances);
+    for (uint8_t i = 0; i < count; i++) {
+      action = &tap_dance_actions[dances[i]];
       if (action->state.count == 0)
         continue;
       action->state.interrupted = true;
@@ -129,26 +230,6 @@ bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
 
 
 
-void matrix_scan_tap_dance () {
-  if (highest_td == -1)
-    return;
-  uint16_t tap_user_defined;
-
-for (uint8_t i = 0; i <= highest_td; i++) {
-    qk_tap_dance_action_t *action = &tap_dance_actions[i];
-    if(action->custom_tapping_term > 0 ) {
-      tap_user_defined = action->custom_tapping_term;
-    }
-    else{
-      tap_user_defined = TAPPING_TERM;
-    }
-    if (action->state.count && timer_elapsed (action->state.timer) > tap_user_defined) {
-      process_tap_dance_action_on_dance_finished (action);
-      reset_tap_dance (&action->state);
-    }
-  }
-}
-
 void reset_tap_dance (qk_tap_dance_state_t *state) {
   qk_tap_dance_action_t *action;
 
@@ -163,4 +244,5 @@ void reset_tap_dance (qk_tap_dance_state_t *state) {
   state->interrupted = false;
   state->finished = false;
   last_td = 0;
+  tap_dance_deactivate (state->keycode - QK_TAP_DANCE);
 }
@@ -34,6 +34,11 @@ typedef struct
 
 #define TD(n) (QK_TAP_DANCE + n)
 
+/* dances that can be going on at the same time */
+#ifndef TAP_DANCE_MAX_ACTIVE
+#define TAP_DANCE_MAX_ACTIVE 4
+#endif
+
 typedef void (*qk_tap_dance_user_fn_t) (qk_tap_dance_state_t *state, void *user_data);
 
 typedef struct
@@ -80,9 +85,11 @@ extern qk_tap_dance_action_t tap_dance_actions[];
 /* To be used internally */
 
 bool process_tap_dance(uint16_t keycode, keyrecord_t *record);
-void matrix_scan_tap_dance (void);
+bool process_tap_dance_sees_all_keys(void);
 void reset_tap_dance (qk_tap_dance_state_t *state);
 
+#define PROCESS_TAP_DANCE_KEYCODES(p) { QK_TAP_DANCE, QK_TAP_DANCE_MAX, p },
+
 void qk_tap_dance_pair_finished (qk_tap_dance_state_t *state, void *user_data);
 void qk_tap_dance_pair_reset (qk_tap_dance_state_t *state, void *user_data);
 
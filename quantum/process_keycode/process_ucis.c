@@ -14,83 +14,187 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include "process_ucis.h"
 
 qk_ucis_state_t qk_ucis_state;
 
-void qk_ucis_start(void) {
-  qk_ucis_state.count = 0;
-  qk_ucis_state.in_progress = true;
+/* Symbols compared while looking up the current input */
+static uint16_t ucis_compared = 0;
 
-  qk_ucis_start_user();
+/* When the table is sorted, the symbols starting with what has been typed
+ * are the range [ucis_first, ucis_last) of it, narrowed down as keys are
+ * typed. An unsorted table is scanned when the input is finished. */
+static uint16_t ucis_table_size = 0;
+static bool ucis_table_ready = false;
+static bool ucis_table_sorted = false;
+static uint16_t ucis_first = 0;
+static uint16_t ucis_last = 0;
+
+static void ucis_table_init(void) {
+  for (ucis_table_size = 0; ucis_symbol_table[ucis_table_size].symbol; ucis_table_size++) {
+  }
+  ucis_table_sorted = true;
+  for (uint16_t i = 1; i < ucis_table_size; i++) {
+    if (strcmp(ucis_symbol_table[i - 1].symbol, ucis_symbol_table[i].symbol) >= 0) {
+      dprintf("ucis: symbol table is not sorted, %s\n", ucis_symbol_table[i].symbol);
+      ucis_table_sorted = false;
+      break;
+    }
+  }
+  ucis_table_ready = true;
 }
 
-__attribute__((weak))
-void qk_ucis_start_user(void) {
-  unicode_input_start();
-  register_hex(0x2328);
-  unicode_input_finish();
+static char ucis_char(uint16_t keycode) {
+  if (KC_A <= keycode && keycode <= KC_Z)
+    return keycode - KC_A + 'a';
+  if (KC_1 <= keycode && keycode <= KC_9)
+    return keycode - KC_1 + '1';
+  if (keycode == KC_0)
+    return '0';
+  return 0;
+}
+
+/* First symbol in [first, last) whose character at depth is not below c,
+ * or with above set, above c */
+static uint16_t ucis_search(uint16_t first, uint16_t last, uint8_t depth, char c, bool above) {
+  while (first < last) {
+    uint16_t mid = first + (last - first) / 2;
+    uint8_t mid_c = ucis_symbol_table[mid].symbol[depth];
+    ucis_compared++;
+    if (mid_c < (uint8_t)c || (above && mid_c == (uint8_t)c)) {
+      first = mid + 1;
+    } else {
+      last = mid;
+    }
+  }
+  return first;
+}
+
+/* Narrows the range down to the symbols with c at depth */
+static void ucis_narrow(uint8_t depth, char c) {
+  if (!c) {
+    ucis_first = ucis_last;
+    return;
+  }
+  ucis_first = ucis_search(ucis_first, ucis_last, depth, c, false);
+  ucis_last = ucis_search(ucis_first, ucis_last, depth, c, true);
+}
+
+static void ucis_narrow_all(void) {
+  ucis_first = 0;
+  ucis_last = ucis_table_size;
+  for (uint8_t i = 0; i < qk_ucis_state.count && ucis_first < ucis_last; i++) {
+    ucis_narrow(i, ucis_char(qk_ucis_state.codes[i]));
+  }
 }
 
 static bool is_uni_seq(char *seq) {
   uint8_t i;
 
+  ucis_compared++;
   for (i = 0; seq[i]; i++) {
-    uint16_t code;
-    if (('1' <= seq[i]) && (seq[i] <= '0'))
-      code = seq[i] - '1' + KC_1;
-    else
-      code = seq[i] - 'a' + KC_A;
-
-    if (i > qk_ucis_state.count || qk_ucis_state.codes[i] != code)
+    if (i >= qk_ucis_state.count - 1 || ucis_char(qk_ucis_state.codes[i]) != seq[i])
       return false;
   }
 
-  return (qk_ucis_state.codes[i] == KC_ENT ||
-          qk_ucis_state.codes[i] == KC_SPC);
+  return i == qk_ucis_state.count - 1;
+}
+
+/* The symbol that is exactly the typed keys, before the last one */
+static const qk_ucis_symbol_t *ucis_lookup(void) {
+  if (!ucis_table_sorted) {
+    for (uint16_t i = 0; i < ucis_table_size; i++) {
+      if (is_uni_seq(ucis_symbol_table[i].symbol)) {
+        return &ucis_symbol_table[i];
+      }
+    }
+    return NULL;
+  }
+  if (ucis_first < ucis_last && !ucis_symbol_table[ucis_first].symbol[qk_ucis_state.count - 1]) {
+    return &ucis_symbol_table[ucis_first];
+  }
+  return NULL;
+}
+
+uint16_t get_ucis_symbols_compared(void) {
+  return ucis_compared;
+}
+
+void qk_ucis_start(void) {
+  qk_ucis_state.count = 0;
+  qk_ucis_state.in_progress = true;
+
+  if (!ucis_table_ready) {
+    ucis_table_init();
+  }
+  ucis_first = 0;
+  ucis_last = ucis_table_size;
+  ucis_compared = 0;
+
+  qk_ucis_start_user();
+}
+
+__attribute__((weak))
+void qk_ucis_start_user(void) {
+  unicode_input_start();
+  register_hex(0x2328);
+  unicode_input_finish();
 }
 
 __attribute__((weak))
 void qk_ucis_symbol_fallback (void) {
   for (uint8_t i = 0; i < qk_ucis_state.count - 1; i++) {
-    uint8_t code = qk_ucis_state.codes[i];
-    register_code(code);
-    unregister_code(code);
-    wait_ms(UNICODE_TYPE_DELAY);
+    unicode_tap_code(qk_ucis_state.codes[i]);
   }
 }
 
 void register_ucis(const char *hex) {
   for(int i = 0; hex[i]; i++) {
-    uint8_t kc = 0;
     char c = hex[i];
 
     switch (c) {
-    case '0':
-      kc = KC_0;
-      break;
-    case '1' ... '9':
-      kc = c - '1' + KC_1;
+    case '0' ... '9':
+      register_hex_digit(c - '0');
       break;
     case 'a' ... 'f':
-      kc = c - 'a' + KC_A;
+      register_hex_digit(c - 'a' + 0xA);
       break;
     case 'A' ... 'F':
-      kc = c - 'A' + KC_A;
+      register_hex_digit(c - 'A' + 0xA);
       break;
     }
+  }
+}
 
-    if (kc) {
-      register_code (kc);
-      unregister_code (kc);
-      wait_ms (UNICODE_TYPE_DELAY);
-    }
+bool process_ucis_sees_all_keys(void) {
+  return qk_ucis_state.in_progress;
+}
+
+/* Erases the typed keys, the last of which was not sent, and the symbol
+ * shown by qk_ucis_start_user() */
+static void ucis_erase(void) {
+  for (uint8_t i = qk_ucis_state.count; i > 0; i--) {
+    unicode_tap_code(KC_BSPC);
   }
 }
 
-bool process_ucis (uint16_t keycode, keyrecord_t *record) {
-  uint8_t i;
+/* Replaces the typed keys with the symbol */
+static void ucis_finish(const qk_ucis_symbol_t *symbol) {
+  ucis_erase();
+  if (symbol) {
+    unicode_input_start();
+    register_ucis(symbol->code + 2);
+    unicode_input_finish();
+  } else {
+    qk_ucis_symbol_fallback();
+    send_keyboard_report();
+  }
+
+  qk_ucis_state.in_progress = false;
+}
 
+bool process_ucis (uint16_t keycode, keyrecord_t *record) {
   if (!qk_ucis_state.in_progress)
     return true;
 
@@ -108,6 +212,9 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
   if (keycode == KC_BSPC) {
     if (qk_ucis_state.count >= 2) {
       qk_ucis_state.count -= 2;
+      if (ucis_table_sorted) {
+        ucis_narrow_all();
+      }
       return true;
     } else {
       qk_ucis_state.count--;
@@ -115,35 +222,27 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
     }
   }
 
-  if (keycode == KC_ENT || keycode == KC_SPC || keycode == KC_ESC) {
-    bool symbol_found = false;
+  if (keycode == KC_ESC) {
+    ucis_erase();
+    send_keyboard_report();
+    qk_ucis_state.in_progress = false;
+    return false;
+  }
 
-    for (i = qk_ucis_state.count; i > 0; i--) {
-      register_code (KC_BSPC);
-      unregister_code (KC_BSPC);
-      wait_ms(UNICODE_TYPE_DELAY);
-    }
+  if (keycode == KC_ENT || keycode == KC_SPC) {
+    ucis_finish(ucis_lookup());
+    return false;
+  }
 
-    if (keycode == KC_ESC) {
-      qk_ucis_state.in_progress = false;
+  if (ucis_table_sorted) {
+    ucis_narrow(qk_ucis_state.count - 1, ucis_char(keycode));
+#ifdef UCIS_EARLY_COMMIT
+    // Only one symbol starts with the typed keys, so it is the one
+    if (ucis_last - ucis_first == 1) {
+      ucis_finish(&ucis_symbol_table[ucis_first]);
       return false;
     }
-
-    unicode_input_start();
-    for (i = 0; ucis_symbol_table[i].symbol; i++) {
-      if (is_uni_seq (ucis_symbol_table[i].symbol)) {
-        symbol_found = true;
-        register_ucis(ucis_symbol_table[i].code + 2);
-        break;
-      }
-    }
-    if (!symbol_found) {
-      qk_ucis_symbol_fallback();
-    }
-    unicode_input_finish();
-
-    qk_ucis_state.in_progress = false;
-    return false;
+#endif
   }
   return true;
 }
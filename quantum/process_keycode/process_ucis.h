@@ -31,7 +31,8 @@ typedef struct {
 
 typedef struct {
   uint8_t count;
-  uint16_t codes[UCIS_MAX_SYMBOL_LENGTH];
+  // One more for the key ending the input
+  uint16_t codes[UCIS_MAX_SYMBOL_LENGTH + 1];
   bool in_progress:1;
 } qk_ucis_state_t;
 
@@ -44,8 +45,16 @@ extern const qk_ucis_symbol_t ucis_symbol_table[];
 
 void qk_ucis_start(void);
 void qk_ucis_start_user(void);
+/* Types the keys of a name that is not in the table, after they have
+ * been erased. It runs outside of unicode input, and its keys go out in
+ * order with the erasing ones when typed with unicode_tap_code(). */
 void qk_ucis_symbol_fallback (void);
 void register_ucis(const char *hex);
+uint16_t get_ucis_symbols_compared(void);
 bool process_ucis (uint16_t keycode, keyrecord_t *record);
+bool process_ucis_sees_all_keys(void);
+
+// UCIS owns no keycodes, it is started by qk_ucis_start()
+#define PROCESS_UCIS_KEYCODES(p)
 
 #endif
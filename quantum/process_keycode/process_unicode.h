@@ -21,4 +21,6 @@
 
 bool process_unicode(uint16_t keycode, keyrecord_t *record);
 
+#define PROCESS_UNICODE_KEYCODES(p) { QK_UNICODE + 1, QK_UNICODE_MAX, p },
+
 #endif
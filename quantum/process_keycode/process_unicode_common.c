@@ -18,7 +18,21 @@
 #include "eeprom.h"
 
 static uint8_t input_mode;
-uint8_t mods;
+
+/* Time between the reports of unicode input, for each input mode */
+static const uint8_t unicode_report_delay[] = {
+  [UC_OSX]  = UNICODE_REPORT_DELAY_OSX,
+  [UC_LNX]  = UNICODE_REPORT_DELAY_LNX,
+  [UC_WIN]  = UNICODE_REPORT_DELAY_WIN,
+  [UC_BSD]  = UNICODE_REPORT_DELAY,
+  [UC_WINC] = UNICODE_REPORT_DELAY_WINC,
+};
+
+/* Unicode input is sent as reports of its own, queued behind each other,
+ * with the keys that are held but without their mods. Mods that have to
+ * stay down while the digits are typed are in unicode_mods. */
+static uint8_t unicode_mods = 0;
+static uint8_t unicode_key = 0;
 
 void set_unicode_input_mode(uint8_t os_target)
 {
@@ -30,69 +44,62 @@ uint8_t get_unicode_input_mode(void) {
   return input_mode;
 }
 
+static uint8_t unicode_delay(void) {
+  return input_mode < sizeof(unicode_report_delay) ? unicode_report_delay[input_mode] : UNICODE_REPORT_DELAY;
+}
+
+static void unicode_send(uint8_t mods, uint8_t key, uint8_t delay) {
+  report_keyboard_t report = *keyboard_report;
+  report.mods = mods;
+  if (key) {
+    add_key_to_report(&report, key);
+  }
+  unicode_key = key;
+  host_keyboard_queue(&report, delay);
+}
+
 __attribute__((weak))
 void unicode_input_start (void) {
-  // save current mods
-  mods = keyboard_report->mods;
-
-  // unregister all mods to start from clean state
-  if (mods & MOD_BIT(KC_LSFT)) unregister_code(KC_LSFT);
-  if (mods & MOD_BIT(KC_RSFT)) unregister_code(KC_RSFT);
-  if (mods & MOD_BIT(KC_LCTL)) unregister_code(KC_LCTL);
-  if (mods & MOD_BIT(KC_RCTL)) unregister_code(KC_RCTL);
-  if (mods & MOD_BIT(KC_LALT)) unregister_code(KC_LALT);
-  if (mods & MOD_BIT(KC_RALT)) unregister_code(KC_RALT);
-  if (mods & MOD_BIT(KC_LGUI)) unregister_code(KC_LGUI);
-  if (mods & MOD_BIT(KC_RGUI)) unregister_code(KC_RGUI);
-
+  // the held mods are left out of the reports, so nothing has to be
+  // unregistered to start from clean state
   switch(input_mode) {
   case UC_OSX:
-    register_code(KC_LALT);
+    unicode_mods = MOD_BIT(KC_LALT);
     break;
   case UC_LNX:
-    register_code(KC_LCTL);
-    register_code(KC_LSFT);
-    register_code(KC_U);
-    unregister_code(KC_U);
-    unregister_code(KC_LSFT);
-    unregister_code(KC_LCTL);
+    unicode_mods = 0;
+    unicode_send(MOD_BIT(KC_LCTL) | MOD_BIT(KC_LSFT), KC_U, unicode_delay());
     break;
   case UC_WIN:
-    register_code(KC_LALT);
-    register_code(KC_PPLS);
-    unregister_code(KC_PPLS);
+    unicode_mods = MOD_BIT(KC_LALT);
+    unicode_send(unicode_mods, KC_PPLS, unicode_delay());
     break;
   case UC_WINC:
-    register_code(KC_RALT);
-    unregister_code(KC_RALT);
-    register_code(KC_U);
-    unregister_code(KC_U);
+    unicode_mods = 0;
+    unicode_send(MOD_BIT(KC_RALT), 0, unicode_delay());
+    unicode_send(0, 0, unicode_delay());
+    unicode_send(0, KC_U, unicode_delay());
+    break;
+  default:
+    unicode_mods = 0;
+    break;
   }
-  wait_ms(UNICODE_TYPE_DELAY);
+  // give the input method time to get ready
+  unicode_send(unicode_mods, 0, UNICODE_TYPE_DELAY);
 }
 
 __attribute__((weak))
 void unicode_input_finish (void) {
   switch(input_mode) {
-    case UC_OSX:
-    case UC_WIN:
-      unregister_code(KC_LALT);
-      break;
     case UC_LNX:
-      register_code(KC_SPC);
-      unregister_code(KC_SPC);
+      unicode_send(0, KC_SPC, unicode_delay());
       break;
   }
+  unicode_mods = 0;
+  unicode_send(0, 0, unicode_delay());
 
-  // reregister previously set mods
-  if (mods & MOD_BIT(KC_LSFT)) register_code(KC_LSFT);
-  if (mods & MOD_BIT(KC_RSFT)) register_code(KC_RSFT);
-  if (mods & MOD_BIT(KC_LCTL)) register_code(KC_LCTL);
-  if (mods & MOD_BIT(KC_RCTL)) register_code(KC_RCTL);
-  if (mods & MOD_BIT(KC_LALT)) register_code(KC_LALT);
-  if (mods & MOD_BIT(KC_RALT)) register_code(KC_RALT);
-  if (mods & MOD_BIT(KC_LGUI)) register_code(KC_LGUI);
-  if (mods & MOD_BIT(KC_RGUI)) register_code(KC_RGUI);
+  // back to the keys and mods that are held
+  send_keyboard_report();
 }
 
 __attribute__((weak))
@@ -107,10 +114,30 @@ uint16_t hex_to_keycode(uint8_t hex)
   }
 }
 
+void unicode_tap_code(uint8_t key) {
+  if (key == unicode_key) {
+    // a key pressed again has to be released in between
+    unicode_send(unicode_mods, 0, unicode_delay());
+  }
+  // the new key replaces the last one, which releases it
+  unicode_send(unicode_mods, key, unicode_delay());
+}
+
+void register_hex_digit(uint8_t digit) {
+  unicode_tap_code(hex_to_keycode(digit));
+}
+
 void register_hex(uint16_t hex) {
-  for(int i = 3; i >= 0; i--) {
-    uint8_t digit = ((hex >> (i*4)) & 0xF);
-    register_code(hex_to_keycode(digit));
-    unregister_code(hex_to_keycode(digit));
+  register_hex32(hex);
+}
+
+void register_hex32(uint32_t hex) {
+  // at least four digits, without leading zeros beyond those
+  int8_t i = 7;
+  while (i > 3 && !((hex >> (i*4)) & 0xF)) {
+    i--;
+  }
+  for (; i >= 0; i--) {
+    register_hex_digit((hex >> (i*4)) & 0xF);
   }
 }
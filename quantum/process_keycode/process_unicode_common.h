@@ -23,14 +23,43 @@
 #define UNICODE_TYPE_DELAY 10
 #endif
 
+/* Time between the reports of unicode input, overridable per input mode */
+#ifndef UNICODE_REPORT_DELAY
+#define UNICODE_REPORT_DELAY 0
+#endif
+#ifndef UNICODE_REPORT_DELAY_OSX
+#define UNICODE_REPORT_DELAY_OSX UNICODE_REPORT_DELAY
+#endif
+#ifndef UNICODE_REPORT_DELAY_LNX
+#define UNICODE_REPORT_DELAY_LNX UNICODE_REPORT_DELAY
+#endif
+#ifndef UNICODE_REPORT_DELAY_WIN
+#define UNICODE_REPORT_DELAY_WIN UNICODE_REPORT_DELAY
+#endif
+#ifndef UNICODE_REPORT_DELAY_WINC
+#define UNICODE_REPORT_DELAY_WINC UNICODE_REPORT_DELAY
+#endif
+
 __attribute__ ((unused))
 static uint8_t input_mode;
 
 void set_unicode_input_mode(uint8_t os_target);
 uint8_t get_unicode_input_mode(void);
+/* Between these, the mods of the input method are only held in the
+ * queued reports, so keys have to be typed with register_hex*() or
+ * unicode_tap_code(); register_code() would release the mods. Keys
+ * registered before or after go out in order with the input. */
 void unicode_input_start(void);
 void unicode_input_finish(void);
+/* Queues a tap of key with the mods of the input method, if any, and
+ * without the mods that are held. The key is released by the next
+ * queued report, so end with unicode_input_finish() or
+ * send_keyboard_report(). */
+void unicode_tap_code(uint8_t key);
 void register_hex(uint16_t hex);
+void register_hex32(uint32_t hex);
+void register_hex_digit(uint8_t digit);
+uint16_t hex_to_keycode(uint8_t hex);
 
 #define UC_OSX 0  // Mac OS X
 #define UC_LNX 1  // Linux
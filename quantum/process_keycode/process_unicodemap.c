@@ -21,26 +21,6 @@ __attribute__((weak))
 const uint32_t PROGMEM unicode_map[] = {
 };
 
-void register_hex32(uint32_t hex) {
-  bool onzerostart = true;
-  for(int i = 7; i >= 0; i--) {
-    if (i <= 3) {
-      onzerostart = false;
-    }
-    uint8_t digit = ((hex >> (i*4)) & 0xF);
-    if (digit == 0) {
-      if (!onzerostart) {
-        register_code(hex_to_keycode(digit));
-        unregister_code(hex_to_keycode(digit));
-      }
-    } else {
-      register_code(hex_to_keycode(digit));
-      unregister_code(hex_to_keycode(digit));
-      onzerostart = false;
-    }
-  }
-}
-
 __attribute__((weak))
 void unicode_map_input_error() {}
 
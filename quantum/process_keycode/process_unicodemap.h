@@ -22,4 +22,6 @@
 
 void unicode_map_input_error(void);
 bool process_unicode_map(uint16_t keycode, keyrecord_t *record);
+
+#define PROCESS_UNICODEMAP_KEYCODES(p) { QK_UNICODE_MAP, 0xFFFF, p },
 #endif
@@ -137,27 +137,231 @@ void reset_keyboard(void) {
 static bool shift_interrupted[2] = {0, 0};
 static uint16_t scs_timer[2] = {0, 0};
 
-bool process_record_quantum(keyrecord_t *record) {
+/* Keycode processors, in the order process_record_quantum() runs them */
+enum keycode_processor {
+#if defined(MIDI_ENABLE) && defined(MIDI_ADVANCED)
+  PROCESSOR_MIDI,
+#endif
+#ifdef AUDIO_ENABLE
+  PROCESSOR_AUDIO,
+#endif
+#if defined(AUDIO_ENABLE) || (defined(MIDI_ENABLE) && defined(MIDI_BASIC))
+  PROCESSOR_MUSIC,
+#endif
+#ifdef TAP_DANCE_ENABLE
+  PROCESSOR_TAP_DANCE,
+#endif
+#ifndef DISABLE_LEADER
+  PROCESSOR_LEADER,
+#endif
+#ifndef DISABLE_CHORDING
+  PROCESSOR_CHORDING,
+#endif
+#ifdef COMBO_ENABLE
+  PROCESSOR_COMBO,
+#endif
+#ifdef UNICODE_ENABLE
+  PROCESSOR_UNICODE,
+#endif
+#ifdef UCIS_ENABLE
+  PROCESSOR_UCIS,
+#endif
+#ifdef PRINTING_ENABLE
+  PROCESSOR_PRINTER,
+#endif
+#ifdef UNICODEMAP_ENABLE
+  PROCESSOR_UNICODEMAP,
+#endif
+  PROCESSOR_COUNT
+};
 
-  /* This gets the keycode from the key pressed */
-  keypos_t key = record->event.key;
-  uint16_t keycode;
+typedef uint16_t processor_mask_t;
 
-  #if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
-    /* TODO: Use store_or_get_action() or a similar function. */
-    if (!disable_action_cache) {
-      uint8_t layer;
+typedef struct {
+  bool (*process)(uint16_t keycode, keyrecord_t *record);
+  /* NULL when the processor only ever needs its own keycodes */
+  bool (*sees_all_keys)(void);
+} keycode_processor_t;
 
-      if (record->event.pressed) {
-        layer = layer_switch_get_layer(key);
-        update_source_layers_cache(key, layer);
-      } else {
-        layer = read_source_layers_cache(key);
+static const keycode_processor_t keycode_processors[] = {
+#if defined(MIDI_ENABLE) && defined(MIDI_ADVANCED)
+  [PROCESSOR_MIDI] = { process_midi, NULL },
+#endif
+#ifdef AUDIO_ENABLE
+  [PROCESSOR_AUDIO] = { process_audio, NULL },
+#endif
+#if defined(AUDIO_ENABLE) || (defined(MIDI_ENABLE) && defined(MIDI_BASIC))
+  [PROCESSOR_MUSIC] = { process_music, is_music_on },
+#endif
+#ifdef TAP_DANCE_ENABLE
+  [PROCESSOR_TAP_DANCE] = { process_tap_dance, process_tap_dance_sees_all_keys },
+#endif
+#ifndef DISABLE_LEADER
+  [PROCESSOR_LEADER] = { process_leader, process_leader_sees_all_keys },
+#endif
+#ifndef DISABLE_CHORDING
+  [PROCESSOR_CHORDING] = { process_chording, NULL },
+#endif
+#ifdef COMBO_ENABLE
+  [PROCESSOR_COMBO] = { process_combo, NULL },
+#endif
+#ifdef UNICODE_ENABLE
+  [PROCESSOR_UNICODE] = { process_unicode, NULL },
+#endif
+#ifdef UCIS_ENABLE
+  [PROCESSOR_UCIS] = { process_ucis, process_ucis_sees_all_keys },
+#endif
+#ifdef PRINTING_ENABLE
+  [PROCESSOR_PRINTER] = { process_printer, process_printer_sees_all_keys },
+#endif
+#ifdef UNICODEMAP_ENABLE
+  [PROCESSOR_UNICODEMAP] = { process_unicode_map, NULL },
+#endif
+};
+
+typedef struct {
+  uint16_t first;
+  uint16_t last;
+  uint8_t processor;
+} keycode_range_t;
+
+/* The keycodes each processor handles, declared by its process_*.h */
+static const keycode_range_t keycode_ranges[] PROGMEM = {
+#if defined(MIDI_ENABLE) && defined(MIDI_ADVANCED)
+  PROCESS_MIDI_KEYCODES(PROCESSOR_MIDI)
+#endif
+#ifdef AUDIO_ENABLE
+  PROCESS_AUDIO_KEYCODES(PROCESSOR_AUDIO)
+#endif
+#if defined(AUDIO_ENABLE) || (defined(MIDI_ENABLE) && defined(MIDI_BASIC))
+  PROCESS_MUSIC_KEYCODES(PROCESSOR_MUSIC)
+#endif
+#ifdef TAP_DANCE_ENABLE
+  PROCESS_TAP_DANCE_KEYCODES(PROCESSOR_TAP_DANCE)
+#endif
+#ifndef DISABLE_LEADER
+  PROCESS_LEADER_KEYCODES(PROCESSOR_LEADER)
+#endif
+#ifndef DISABLE_CHORDING
+  PROCESS_CHORDING_KEYCODES(PROCESSOR_CHORDING)
+#endif
+#ifdef COMBO_ENABLE
+  PROCESS_COMBO_KEYCODES(PROCESSOR_COMBO)
+#endif
+#ifdef UNICODE_ENABLE
+  PROCESS_UNICODE_KEYCODES(PROCESSOR_UNICODE)
+#endif
+#ifdef UCIS_ENABLE
+  PROCESS_UCIS_KEYCODES(PROCESSOR_UCIS)
+#endif
+#ifdef PRINTING_ENABLE
+  PROCESS_PRINTER_KEYCODES(PROCESSOR_PRINTER)
+#endif
+#ifdef UNICODEMAP_ENABLE
+  PROCESS_UNICODEMAP_KEYCODES(PROCESSOR_UNICODEMAP)
+#endif
+};
+
+#define KEYCODE_RANGE_COUNT (sizeof(keycode_ranges) / sizeof(keycode_ranges[0]))
+
+/* Sorted index of the keycode ranges: segment i starts at
+ * keycode_index_start[i] and is handled by the processors in
+ * keycode_index_mask[i]. The first segment always starts at 0. */
+static uint16_t keycode_index_start[2 * KEYCODE_RANGE_COUNT + 1];
+static processor_mask_t keycode_index_mask[2 * KEYCODE_RANGE_COUNT + 1];
+static uint8_t keycode_index_size = 0;
+
+/* The processors that can ask to see keys outside their ranges */
+static processor_mask_t keycode_index_all_keys;
+
+static uint8_t processor_visits = 0;
+
+static void keycode_index_add(uint16_t start) {
+  uint8_t i = keycode_index_size;
+  while (i > 0 && keycode_index_start[i - 1] > start) {
+    i--;
+  }
+  if (i > 0 && keycode_index_start[i - 1] == start) {
+    return;
+  }
+  for (uint8_t j = keycode_index_size; j > i; j--) {
+    keycode_index_start[j] = keycode_index_start[j - 1];
+  }
+  keycode_index_start[i] = start;
+  keycode_index_size++;
+}
+
+static void keycode_index_init(void) {
+  keycode_index_add(0);
+  for (uint8_t r = 0; r < KEYCODE_RANGE_COUNT; r++) {
+    uint16_t last = pgm_read_word(&keycode_ranges[r].last);
+    keycode_index_add(pgm_read_word(&keycode_ranges[r].first));
+    if (last != 0xFFFF) {
+      keycode_index_add(last + 1);
+    }
+  }
+  /* Segments never straddle a range boundary, so checking their start is enough */
+  for (uint8_t i = 0; i < keycode_index_size; i++) {
+    processor_mask_t mask = 0;
+    for (uint8_t r = 0; r < KEYCODE_RANGE_COUNT; r++) {
+      if (pgm_read_word(&keycode_ranges[r].first) <= keycode_index_start[i] &&
+          keycode_index_start[i] <= pgm_read_word(&keycode_ranges[r].last)) {
+        mask |= (processor_mask_t)1 << pgm_read_byte(&keycode_ranges[r].processor);
       }
-      keycode = keymap_key_to_keycode(layer, key);
-    } else
-  #endif
-    keycode = keymap_key_to_keycode(layer_switch_get_layer(key), key);
+    }
+    keycode_index_mask[i] = mask;
+  }
+  for (uint8_t p = 0; p < PROCESSOR_COUNT; p++) {
+    if (keycode_processors[p].sees_all_keys) {
+      keycode_index_all_keys |= (processor_mask_t)1 << p;
+    }
+  }
+}
+
+static processor_mask_t keycode_index_lookup(uint16_t keycode) {
+  uint8_t lo = 0;
+  uint8_t hi = keycode_index_size;
+  while (hi - lo > 1) {
+    uint8_t mid = (lo + hi) / 2;
+    if (keycode_index_start[mid] <= keycode) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return keycode_index_mask[lo];
+}
+
+/* Runs the processors that handle this keycode, or currently want to see
+ * every key, in chain order until one of them consumes the event */
+static bool process_keycode_processors(uint16_t keycode, keyrecord_t *record) {
+  if (keycode_index_size == 0) {
+    keycode_index_init();
+  }
+
+  processor_mask_t owners = keycode_index_lookup(keycode);
+  processor_mask_t pending = owners | keycode_index_all_keys;
+  for (; pending; pending &= pending - 1) {
+    uint8_t p = bitctz16(pending);
+    if (!(owners & ((processor_mask_t)1 << p)) && !keycode_processors[p].sees_all_keys()) {
+      continue;
+    }
+    processor_visits++;
+    if (!keycode_processors[p].process(keycode, record)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint8_t get_processor_visits(void) {
+  return processor_visits;
+}
+
+bool process_record_quantum(keyrecord_t *record) {
+
+  /* The keycode has already been resolved by process_record() */
+  uint16_t keycode = record->keycode;
 
     // This is how you use actions here
     // if (keycode == KC_LEAD) {
@@ -167,42 +371,10 @@ bool process_record_quantum(keyrecord_t *record) {
     //   return false;
     // }
 
+  processor_visits = 0;
   if (!(
     process_record_kb(keycode, record) &&
-  #if defined(MIDI_ENABLE) && defined(MIDI_ADVANCED)
-    process_midi(keycode, record) &&
-  #endif
-  #ifdef AUDIO_ENABLE
-    process_audio(keycode, record) &&
-  #endif
-  #if defined(AUDIO_ENABLE) || (defined(MIDI_ENABLE) && defined(MIDI_BASIC))
-    process_music(keycode, record) &&
-  #endif
-  #ifdef TAP_DANCE_ENABLE
-    process_tap_dance(keycode, record) &&
-  #endif
-  #ifndef DISABLE_LEADER
-    process_leader(keycode, record) &&
-  #endif
-  #ifndef DISABLE_CHORDING
-    process_chording(keycode, record) &&
-  #endif
-  #ifdef COMBO_ENABLE
-    process_combo(keycode, record) &&
-  #endif
-  #ifdef UNICODE_ENABLE
-    process_unicode(keycode, record) &&
-  #endif
-  #ifdef UCIS_ENABLE
-    process_ucis(keycode, record) &&
-  #endif
-  #ifdef PRINTING_ENABLE
-    process_printer(keycode, record) &&
-  #endif
-  #ifdef UNICODEMAP_ENABLE
-    process_unicode_map(keycode, record) &&
-  #endif
-      true)) {
+    process_keycode_processors(keycode, record))) {
     return false;
   }
 
@@ -455,206 +627,88 @@ bool process_record_quantum(keyrecord_t *record) {
   return process_action_kb(record);
 }
 
-#ifdef JIS_KEYCODE
-static const uint16_t ascii_to_shift_lut[8] PROGMEM = {
-  0x0000, /*0, 0, 0, 0, 0, 0, 0, 0,
-            0, 0, 0, 0, 0, 0, 0, 0,*/
-  0x0000, /*0, 0, 0, 0, 0, 0, 0, 0,
-            0, 0, 0, 0, 0, 0, 0, 0,*/
-  0x7ff0, /*0, 1, 1, 1, 1, 1, 1, 1,
-            1, 1, 1, 1, 0, 0, 0, 0,*/
-  0x000f, /*0, 0, 0, 0, 0, 0, 0, 0,
-            0, 0, 0, 0, 1, 1, 1, 1,*/
-  0x7fff, /*0, 1, 1, 1, 1, 1, 1, 1,
-            1, 1, 1, 1, 1, 1, 1, 1,*/
-  0xffe1, /*1, 1, 1, 1, 1, 1, 1, 1,
-            1, 1, 1, 0, 0, 0, 0, 1,*/
-  0x8000, /*1, 0, 0, 0, 0, 0, 0, 0,
-            0, 0, 0, 0, 0, 0, 0, 0,*/
-  0x001e, /*0, 0, 0, 0, 0, 0, 0, 0,
-            0, 0, 0, 1, 1, 1, 1, 0*/
-};
+static void type_char(uint8_t ascii_code) {
+    uint8_t packed = send_string_layout_char(ascii_code);
+    uint8_t keycode = send_string_layout_key(packed);
+    if (!keycode) return;
+
+    if (packed & SS_ALGR) register_code(KC_RALT);
+    if (packed & SS_SHIFT) register_code(KC_LSFT);
+    register_code(keycode);
+    unregister_code(keycode);
+    if (packed & SS_SHIFT) unregister_code(KC_LSFT);
+    if (packed & SS_ALGR) unregister_code(KC_RALT);
+}
 
-static const struct {
-  uint8_t controls_0[16],
-          controls_1[16],
-          numerics[16],
-          alphabets_0[16],
-          alphabets_1[16];
-} lower_to_keycode PROGMEM = {
-  .controls_0 = {
-    0, 0, 0, 0, 0, 0, 0, 0,
-    KC_BSPC, KC_TAB, KC_ENT, 0, 0, 0, 0, 0, 
-  },
-  .controls_1 = {
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, KC_ESC, 0, 0, 0, 0,
-  },
-  .numerics = {
-    KC_0, KC_1, KC_2, KC_3, KC_4, KC_5, KC_6, KC_7,
-    KC_8, KC_9, KC_QUOT, KC_SCLN, KC_COMM, KC_MINS, KC_DOT, KC_SLSH,
-  },
-  .alphabets_0 = {
-    KC_LBRC, KC_A, KC_B, KC_C, KC_D, KC_E, KC_F, KC_G,
-    KC_H, KC_I, KC_J, KC_K, KC_L, KC_M, KC_N, KC_O,
-  },
-  .alphabets_1 = {
-    KC_P, KC_Q, KC_R, KC_S, KC_T, KC_U, KC_V, KC_W,
-    KC_X, KC_Y, KC_Z, KC_RBRC, KC_JYEN, KC_BSLS, KC_EQL, KC_RO,
-  },
-};
-static const uint8_t* ascii_to_keycode_lut[8] = {
-  lower_to_keycode.controls_0,
-  lower_to_keycode.controls_1,
-  lower_to_keycode.numerics,
-  lower_to_keycode.numerics,
-  lower_to_keycode.alphabets_0,
-  lower_to_keycode.alphabets_1,
-  lower_to_keycode.alphabets_0,
-  lower_to_keycode.alphabets_1
-};
+#ifdef SEND_STRING_QUEUE
+static char send_string_queue[SEND_STRING_QUEUE_SIZE];
+static uint8_t send_string_head = 0;
+static uint8_t send_string_count = 0;
+static uint16_t send_string_stall_count = 0;
+
+// Number of reports it takes to type the character
+static uint8_t char_reports(uint8_t ascii_code) {
+    uint8_t packed = send_string_layout_char(ascii_code);
+    if (!send_string_layout_key(packed)) return 0;
+    return 2 + (packed & SS_SHIFT ? 2 : 0) + (packed & SS_ALGR ? 2 : 0);
+}
 
-void send_string(const char *str) {
-    while (1) {
-        uint8_t keycode;
-        bool shift;
-        uint8_t ascii_code = pgm_read_byte(str);
-
-        if ( ascii_code == 0x00u ){ break; }
-        else if (ascii_code == 0x20u) {
-          keycode = KC_SPC;
-          shift = false;
-        }
-        else if (ascii_code == 0x7Fu) {
-          keycode = KC_DEL;
-          shift = false;
-        }
-        else {
-          int hi = ascii_code>>4 & 0x0f,
-              lo = ascii_code & 0x0f;
-          keycode = pgm_read_byte(&ascii_to_keycode_lut[hi][lo]);
-          shift = !!( pgm_read_word(&ascii_to_shift_lut[hi]) & (0x8000u>>lo) );
-        }
+static void send_string_pop(void) {
+    char ascii_code = send_string_queue[send_string_head];
+    send_string_head = (send_string_head + 1) % SEND_STRING_QUEUE_SIZE;
+    send_string_count--;
+    type_char(ascii_code);
+}
 
-        if (shift) {
-            register_code(KC_LSFT);
-            register_code(keycode);
-            unregister_code(keycode);
-            unregister_code(KC_LSFT);
-        }
-        else {
-            register_code(keycode);
-            unregister_code(keycode);
-        }
-        ++str;
+void send_char(char ascii_code) {
+    if (send_string_count == SEND_STRING_QUEUE_SIZE) {
+        // no room, make some by typing the oldest character right away
+        send_string_pop();
+        send_string_stall_count++;
     }
+    send_string_queue[(send_string_head + send_string_count) % SEND_STRING_QUEUE_SIZE] = ascii_code;
+    send_string_count++;
 }
 
-#else
-static const bool ascii_to_qwerty_shift_lut[0x80] PROGMEM = {
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 1, 1, 1, 1, 1, 1, 0,
-    1, 1, 1, 1, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 1, 0, 1, 0, 1, 1,
-    1, 1, 1, 1, 1, 1, 1, 1,
-    1, 1, 1, 1, 1, 1, 1, 1,
-    1, 1, 1, 1, 1, 1, 1, 1,
-    1, 1, 1, 0, 0, 0, 1, 1,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 1, 1, 1, 1, 0
-};
+void send_string_task(void) {
+    uint8_t reports = 0;
+    while (send_string_count) {
+        uint8_t next = char_reports(send_string_queue[send_string_head]);
+        // always type at least one character, even when it takes more
+        if (reports && reports + next > SEND_STRING_REPORTS_PER_SCAN) break;
+        send_string_pop();
+        reports += next;
+    }
+}
 
-static const uint8_t ascii_to_qwerty_keycode_lut[0x80] PROGMEM = {
-    0, 0, 0, 0, 0, 0, 0, 0,
-    KC_BSPC, KC_TAB, KC_ENT, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, KC_ESC, 0, 0, 0, 0,
-    KC_SPC, KC_1, KC_QUOT, KC_3, KC_4, KC_5, KC_7, KC_QUOT,
-    KC_9, KC_0, KC_8, KC_EQL, KC_COMM, KC_MINS, KC_DOT, KC_SLSH,
-    KC_0, KC_1, KC_2, KC_3, KC_4, KC_5, KC_6, KC_7,
-    KC_8, KC_9, KC_SCLN, KC_SCLN, KC_COMM, KC_EQL, KC_DOT, KC_SLSH,
-    KC_2, KC_A, KC_B, KC_C, KC_D, KC_E, KC_F, KC_G,
-    KC_H, KC_I, KC_J, KC_K, KC_L, KC_M, KC_N, KC_O,
-    KC_P, KC_Q, KC_R, KC_S, KC_T, KC_U, KC_V, KC_W,
-    KC_X, KC_Y, KC_Z, KC_LBRC, KC_BSLS, KC_RBRC, KC_6, KC_MINS,
-    KC_GRV, KC_A, KC_B, KC_C, KC_D, KC_E, KC_F, KC_G,
-    KC_H, KC_I, KC_J, KC_K, KC_L, KC_M, KC_N, KC_O,
-    KC_P, KC_Q, KC_R, KC_S, KC_T, KC_U, KC_V, KC_W,
-    KC_X, KC_Y, KC_Z, KC_LBRC, KC_BSLS, KC_RBRC, KC_GRV, KC_DEL
-};
+void send_string_flush(void) {
+    while (send_string_count) {
+        send_string_pop();
+    }
+}
+
+uint8_t send_string_queue_space(void) {
+    return SEND_STRING_QUEUE_SIZE - send_string_count;
+}
+
+uint16_t send_string_stalls(void) {
+    return send_string_stall_count;
+}
+#else
+void send_char(char ascii_code) {
+    type_char(ascii_code);
+}
+#endif
 
 void send_string(const char *str) {
     while (1) {
-        uint8_t keycode;
-        uint8_t ascii_code = pgm_read_byte(str);
+        char ascii_code = pgm_read_byte(str);
         if (!ascii_code) break;
-        keycode = pgm_read_byte(&ascii_to_qwerty_keycode_lut[ascii_code]);
-        if (pgm_read_byte(&ascii_to_qwerty_shift_lut[ascii_code])) {
-            register_code(KC_LSFT);
-            register_code(keycode);
-            unregister_code(keycode);
-            unregister_code(KC_LSFT);
-        }
-        else {
-            register_code(keycode);
-            unregister_code(keycode);
-        }
+        send_char(ascii_code);
         ++str;
     }
 }
 
-#endif
-
-/* for users whose OSes are set to Colemak */
-#if 0
-#include "keymap_colemak.h"
-
-const bool ascii_to_colemak_shift_lut[0x80] PROGMEM = {
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 1, 1, 1, 1, 1, 1, 0,
-    1, 1, 1, 1, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 1, 0, 1, 0, 1, 1,
-    1, 1, 1, 1, 1, 1, 1, 1,
-    1, 1, 1, 1, 1, 1, 1, 1,
-    1, 1, 1, 1, 1, 1, 1, 1,
-    1, 1, 1, 0, 0, 0, 1, 1,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 1, 1, 1, 1, 0
-};
-
-const uint8_t ascii_to_colemak_keycode_lut[0x80] PROGMEM = {
-    0, 0, 0, 0, 0, 0, 0, 0,
-    KC_BSPC, KC_TAB, KC_ENT, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, KC_ESC, 0, 0, 0, 0,
-    KC_SPC, KC_1, KC_QUOT, KC_3, KC_4, KC_5, KC_7, KC_QUOT,
-    KC_9, KC_0, KC_8, KC_EQL, KC_COMM, KC_MINS, KC_DOT, KC_SLSH,
-    KC_0, KC_1, KC_2, KC_3, KC_4, KC_5, KC_6, KC_7,
-    KC_8, KC_9, CM_SCLN, CM_SCLN, KC_COMM, KC_EQL, KC_DOT, KC_SLSH,
-    KC_2, CM_A, CM_B, CM_C, CM_D, CM_E, CM_F, CM_G,
-    CM_H, CM_I, CM_J, CM_K, CM_L, CM_M, CM_N, CM_O,
-    CM_P, CM_Q, CM_R, CM_S, CM_T, CM_U, CM_V, CM_W,
-    CM_X, CM_Y, CM_Z, KC_LBRC, KC_BSLS, KC_RBRC, KC_6, KC_MINS,
-    KC_GRV, CM_A, CM_B, CM_C, CM_D, CM_E, CM_F, CM_G,
-    CM_H, CM_I, CM_J, CM_K, CM_L, CM_M, CM_N, CM_O,
-    CM_P, CM_Q, CM_R, CM_S, CM_T, CM_U, CM_V, CM_W,
-    CM_X, CM_Y, CM_Z, KC_LBRC, KC_BSLS, KC_RBRC, KC_GRV, KC_DEL
-};
-
-#endif
-
 void update_tri_layer(uint8_t layer1, uint8_t layer2, uint8_t layer3) {
   if (IS_LAYER_ON(layer1) && IS_LAYER_ON(layer2)) {
     layer_on(layer3);
@@ -663,42 +717,16 @@ void update_tri_layer(uint8_t layer1, uint8_t layer2, uint8_t layer3) {
   }
 }
 
+static const char base64_alphabet[] PROGMEM =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
 void tap_random_base64(void) {
   #if defined(__AVR_ATmega32U4__)
     uint8_t key = (TCNT0 + TCNT1 + TCNT3 + TCNT4) % 64;
   #else
     uint8_t key = rand() % 64;
   #endif
-  switch (key) {
-    case 0 ... 25:
-      register_code(KC_LSFT);
-      register_code(key + KC_A);
-      unregister_code(key + KC_A);
-      unregister_code(KC_LSFT);
-      break;
-    case 26 ... 51:
-      register_code(key - 26 + KC_A);
-      unregister_code(key - 26 + KC_A);
-      break;
-    case 52:
-      register_code(KC_0);
-      unregister_code(KC_0);
-      break;
-    case 53 ... 61:
-      register_code(key - 53 + KC_1);
-      unregister_code(key - 53 + KC_1);
-      break;
-    case 62:
-      register_code(KC_LSFT);
-      register_code(KC_EQL);
-      unregister_code(KC_EQL);
-      unregister_code(KC_LSFT);
-      break;
-    case 63:
-      register_code(KC_SLSH);
-      unregister_code(KC_SLSH);
-      break;
-  }
+  send_char(pgm_read_byte(&base64_alphabet[key]));
 }
 
 void matrix_init_quantum() {
@@ -713,19 +741,19 @@ void matrix_scan_quantum() {
     matrix_scan_music();
   #endif
 
-  #ifdef TAP_DANCE_ENABLE
-    matrix_scan_tap_dance();
-  #endif
-
-  #ifdef COMBO_ENABLE
-    matrix_scan_combo();
-  #endif
-
   #if defined(BACKLIGHT_ENABLE) && defined(BACKLIGHT_PIN)
     backlight_task();
   #endif
 
+  #ifdef SEND_STRING_QUEUE
+    send_string_task();
+  #endif
+
   matrix_scan_kb();
+
+  #ifndef DISABLE_LEADER
+    matrix_scan_leader();
+  #endif
 }
 
 #if defined(BACKLIGHT_ENABLE) && defined(BACKLIGHT_PIN)
@@ -1105,17 +1133,11 @@ void send_byte(uint8_t number) {
 
 void send_nibble(uint8_t number) {
     switch (number) {
-        case 0:
-            register_code(KC_0);
-            unregister_code(KC_0);
-            break;
-        case 1 ... 9:
-            register_code(KC_1 + (number - 1));
-            unregister_code(KC_1 + (number - 1));
+        case 0 ... 9:
+            send_char('0' + number);
             break;
         case 0xA ... 0xF:
-            register_code(KC_A + (number - 0xA));
-            unregister_code(KC_A + (number - 0xA));
+            send_char('a' + (number - 0xA));
             break;
     }
 }
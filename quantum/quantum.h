@@ -40,6 +40,7 @@
 #include "action_util.h"
 #include <stdlib.h>
 #include "print.h"
+#include "send_string_layouts.h"
 
 
 extern uint32_t default_layer_state;
@@ -96,6 +97,24 @@ extern uint32_t default_layer_state;
 
 #define SEND_STRING(str) send_string(PSTR(str))
 void send_string(const char *str);
+void send_char(char ascii_code);
+
+#ifdef SEND_STRING_QUEUE
+#ifndef SEND_STRING_QUEUE_SIZE
+#define SEND_STRING_QUEUE_SIZE 64
+#endif
+#ifndef SEND_STRING_REPORTS_PER_SCAN
+#define SEND_STRING_REPORTS_PER_SCAN 4
+#endif
+// Types queued characters until SEND_STRING_REPORTS_PER_SCAN reports went out
+void send_string_task(void);
+// Types all queued characters right away
+void send_string_flush(void);
+// Number of characters that can be queued before send_string has to block
+uint8_t send_string_queue_space(void);
+// Number of characters typed right away because the queue was full
+uint16_t send_string_stalls(void);
+#endif
 
 // For tri-layer
 void update_tri_layer(uint8_t layer1, uint8_t layer2, uint8_t layer3);
@@ -113,6 +132,9 @@ bool process_action_kb(keyrecord_t *record);
 bool process_record_kb(uint16_t keycode, keyrecord_t *record);
 bool process_record_user(uint16_t keycode, keyrecord_t *record);
 
+// Number of keycode processors the last event was dispatched to
+uint8_t get_processor_visits(void);
+
 void reset_keyboard(void);
 
 void startup_user(void);
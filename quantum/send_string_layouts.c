@@ -0,0 +1,185 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "send_string_layouts.h"
+#include "quantum_keycodes.h"
+#include "keymap_extras/keymap_colemak.h"
+#include "keymap_extras/keymap_dvorak.h"
+#include "keymap_extras/keymap_french.h"
+#include "eeconfig.h"
+#include "eeprom.h"
+
+#define K(code) SS_PACK(code)
+
+// What to tap for each ASCII character, on a host set to each layout
+static const uint8_t ss_layout_qwerty[0x80] PROGMEM = {
+    0, 0, 0, 0, 0, 0, 0, 0,
+    K(KC_BSPC), K(KC_TAB), K(KC_ENT), 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, K(KC_ESC), 0, 0, 0, 0,
+    K(KC_SPC), K(S(KC_1)), K(S(KC_QUOT)), K(S(KC_3)), K(S(KC_4)), K(S(KC_5)), K(S(KC_7)), K(KC_QUOT),
+    K(S(KC_9)), K(S(KC_0)), K(S(KC_8)), K(S(KC_EQL)), K(KC_COMM), K(KC_MINS), K(KC_DOT), K(KC_SLSH),
+    K(KC_0), K(KC_1), K(KC_2), K(KC_3), K(KC_4), K(KC_5), K(KC_6), K(KC_7),
+    K(KC_8), K(KC_9), K(S(KC_SCLN)), K(KC_SCLN), K(S(KC_COMM)), K(KC_EQL), K(S(KC_DOT)), K(S(KC_SLSH)),
+    K(S(KC_2)), K(S(KC_A)), K(S(KC_B)), K(S(KC_C)), K(S(KC_D)), K(S(KC_E)), K(S(KC_F)), K(S(KC_G)),
+    K(S(KC_H)), K(S(KC_I)), K(S(KC_J)), K(S(KC_K)), K(S(KC_L)), K(S(KC_M)), K(S(KC_N)), K(S(KC_O)),
+    K(S(KC_P)), K(S(KC_Q)), K(S(KC_R)), K(S(KC_S)), K(S(KC_T)), K(S(KC_U)), K(S(KC_V)), K(S(KC_W)),
+    K(S(KC_X)), K(S(KC_Y)), K(S(KC_Z)), K(KC_LBRC), K(KC_BSLS), K(KC_RBRC), K(S(KC_6)), K(S(KC_MINS)),
+    K(KC_GRV), K(KC_A), K(KC_B), K(KC_C), K(KC_D), K(KC_E), K(KC_F), K(KC_G),
+    K(KC_H), K(KC_I), K(KC_J), K(KC_K), K(KC_L), K(KC_M), K(KC_N), K(KC_O),
+    K(KC_P), K(KC_Q), K(KC_R), K(KC_S), K(KC_T), K(KC_U), K(KC_V), K(KC_W),
+    K(KC_X), K(KC_Y), K(KC_Z), K(S(KC_LBRC)), K(S(KC_BSLS)), K(S(KC_RBRC)), K(S(KC_GRV)), K(KC_DEL),
+};
+
+#if SS_LAYOUT_ENABLED(SS_COLEMAK)
+static const uint8_t ss_layout_colemak[0x80] PROGMEM = {
+    0, 0, 0, 0, 0, 0, 0, 0,
+    K(KC_BSPC), K(KC_TAB), K(KC_ENT), 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, K(KC_ESC), 0, 0, 0, 0,
+    K(KC_SPC), K(S(KC_1)), K(S(KC_QUOT)), K(S(KC_3)), K(S(KC_4)), K(S(KC_5)), K(S(KC_7)), K(KC_QUOT),
+    K(S(KC_9)), K(S(KC_0)), K(S(KC_8)), K(S(KC_EQL)), K(KC_COMM), K(KC_MINS), K(KC_DOT), K(KC_SLSH),
+    K(KC_0), K(KC_1), K(KC_2), K(KC_3), K(KC_4), K(KC_5), K(KC_6), K(KC_7),
+    K(KC_8), K(KC_9), K(S(CM_SCLN)), K(CM_SCLN), K(S(KC_COMM)), K(KC_EQL), K(S(KC_DOT)), K(S(KC_SLSH)),
+    K(S(KC_2)), K(S(CM_A)), K(S(CM_B)), K(S(CM_C)), K(S(CM_D)), K(S(CM_E)), K(S(CM_F)), K(S(CM_G)),
+    K(S(CM_H)), K(S(CM_I)), K(S(CM_J)), K(S(CM_K)), K(S(CM_L)), K(S(CM_M)), K(S(CM_N)), K(S(CM_O)),
+    K(S(CM_P)), K(S(CM_Q)), K(S(CM_R)), K(S(CM_S)), K(S(CM_T)), K(S(CM_U)), K(S(CM_V)), K(S(CM_W)),
+    K(S(CM_X)), K(S(CM_Y)), K(S(CM_Z)), K(KC_LBRC), K(KC_BSLS), K(KC_RBRC), K(S(KC_6)), K(S(KC_MINS)),
+    K(KC_GRV), K(CM_A), K(CM_B), K(CM_C), K(CM_D), K(CM_E), K(CM_F), K(CM_G),
+    K(CM_H), K(CM_I), K(CM_J), K(CM_K), K(CM_L), K(CM_M), K(CM_N), K(CM_O),
+    K(CM_P), K(CM_Q), K(CM_R), K(CM_S), K(CM_T), K(CM_U), K(CM_V), K(CM_W),
+    K(CM_X), K(CM_Y), K(CM_Z), K(S(KC_LBRC)), K(S(KC_BSLS)), K(S(KC_RBRC)), K(S(KC_GRV)), K(KC_DEL),
+};
+#endif
+
+#if SS_LAYOUT_ENABLED(SS_DVORAK)
+static const uint8_t ss_layout_dvorak[0x80] PROGMEM = {
+    0, 0, 0, 0, 0, 0, 0, 0,
+    K(KC_BSPC), K(KC_TAB), K(KC_ENT), 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, K(KC_ESC), 0, 0, 0, 0,
+    K(KC_SPC), K(DV_EXLM), K(DV_DQUO), K(DV_HASH), K(DV_DLR), K(DV_PERC), K(DV_AMPR), K(DV_QUOT),
+    K(DV_LPRN), K(DV_RPRN), K(DV_ASTR), K(DV_PLUS), K(DV_COMM), K(DV_MINS), K(DV_DOT), K(DV_SLSH),
+    K(DV_0), K(DV_1), K(DV_2), K(DV_3), K(DV_4), K(DV_5), K(DV_6), K(DV_7),
+    K(DV_8), K(DV_9), K(DV_COLN), K(DV_SCLN), K(DV_LABK), K(DV_EQL), K(DV_RABK), K(DV_QUES),
+    K(DV_AT), K(S(DV_A)), K(S(DV_B)), K(S(DV_C)), K(S(DV_D)), K(S(DV_E)), K(S(DV_F)), K(S(DV_G)),
+    K(S(DV_H)), K(S(DV_I)), K(S(DV_J)), K(S(DV_K)), K(S(DV_L)), K(S(DV_M)), K(S(DV_N)), K(S(DV_O)),
+    K(S(DV_P)), K(S(DV_Q)), K(S(DV_R)), K(S(DV_S)), K(S(DV_T)), K(S(DV_U)), K(S(DV_V)), K(S(DV_W)),
+    K(S(DV_X)), K(S(DV_Y)), K(S(DV_Z)), K(DV_LBRC), K(DV_BSLS), K(DV_RBRC), K(DV_CIRC), K(DV_UNDS),
+    K(DV_GRV), K(DV_A), K(DV_B), K(DV_C), K(DV_D), K(DV_E), K(DV_F), K(DV_G),
+    K(DV_H), K(DV_I), K(DV_J), K(DV_K), K(DV_L), K(DV_M), K(DV_N), K(DV_O),
+    K(DV_P), K(DV_Q), K(DV_R), K(DV_S), K(DV_T), K(DV_U), K(DV_V), K(DV_W),
+    K(DV_X), K(DV_Y), K(DV_Z), K(DV_LCBR), K(DV_PIPE), K(DV_RCBR), K(DV_TILD), K(KC_DEL),
+};
+#endif
+
+#if SS_LAYOUT_ENABLED(SS_AZERTY)
+static const uint8_t ss_layout_azerty[0x80] PROGMEM = {
+    0, 0, 0, 0, 0, 0, 0, 0,
+    K(KC_BSPC), K(KC_TAB), K(KC_ENT), 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, K(KC_ESC), 0, 0, 0, 0,
+    K(KC_SPC), K(FR_EXLM), K(FR_QUOT), K(FR_HASH), K(FR_DLR), K(FR_PERC), K(FR_AMP), K(FR_APOS),
+    K(FR_LPRN), K(FR_RPRN), K(FR_ASTR), K(FR_PLUS), K(FR_COMM), K(FR_MINS), K(FR_DOT), K(FR_SLSH),
+    K(FR_0), K(FR_1), K(FR_2), K(FR_3), K(FR_4), K(FR_5), K(FR_6), K(FR_7),
+    K(FR_8), K(FR_9), K(FR_COLN), K(FR_SCLN), K(FR_LESS), K(FR_EQL), K(FR_GRTR), K(FR_QUES),
+    K(FR_AT), K(S(FR_A)), K(S(KC_B)), K(S(KC_C)), K(S(KC_D)), K(S(KC_E)), K(S(KC_F)), K(S(KC_G)),
+    K(S(KC_H)), K(S(KC_I)), K(S(KC_J)), K(S(KC_K)), K(S(KC_L)), K(S(FR_M)), K(S(KC_N)), K(S(KC_O)),
+    K(S(KC_P)), K(S(FR_Q)), K(S(KC_R)), K(S(KC_S)), K(S(KC_T)), K(S(KC_U)), K(S(KC_V)), K(S(FR_W)),
+    K(S(KC_X)), K(S(KC_Y)), K(S(FR_Z)), K(FR_LBRC), K(FR_BSLS), K(FR_RBRC), K(FR_CCIRC), K(FR_UNDS),
+    K(FR_GRV), K(FR_A), K(KC_B), K(KC_C), K(KC_D), K(KC_E), K(KC_F), K(KC_G),
+    K(KC_H), K(KC_I), K(KC_J), K(KC_K), K(KC_L), K(FR_M), K(KC_N), K(KC_O),
+    K(KC_P), K(FR_Q), K(KC_R), K(KC_S), K(KC_T), K(KC_U), K(KC_V), K(FR_W),
+    K(KC_X), K(KC_Y), K(FR_Z), K(FR_LCBR), K(FR_PIPE), K(FR_RCBR), K(FR_TILD), K(KC_DEL),
+};
+#endif
+
+#if SS_LAYOUT_ENABLED(SS_JIS)
+static const uint8_t ss_layout_jis[0x80] PROGMEM = {
+    0, 0, 0, 0, 0, 0, 0, 0,
+    K(KC_BSPC), K(KC_TAB), K(KC_ENT), 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, K(KC_ESC), 0, 0, 0, 0,
+    K(KC_SPC), K(S(KC_1)), K(S(KC_2)), K(S(KC_3)), K(S(KC_4)), K(S(KC_5)), K(S(KC_6)), K(S(KC_7)),
+    K(S(KC_8)), K(S(KC_9)), K(S(KC_QUOT)), K(S(KC_SCLN)), K(KC_COMM), K(KC_MINS), K(KC_DOT), K(KC_SLSH),
+    K(KC_0), K(KC_1), K(KC_2), K(KC_3), K(KC_4), K(KC_5), K(KC_6), K(KC_7),
+    K(KC_8), K(KC_9), K(KC_QUOT), K(KC_SCLN), K(S(KC_COMM)), K(S(KC_MINS)), K(S(KC_DOT)), K(S(KC_SLSH)),
+    K(KC_LBRC), K(S(KC_A)), K(S(KC_B)), K(S(KC_C)), K(S(KC_D)), K(S(KC_E)), K(S(KC_F)), K(S(KC_G)),
+    K(S(KC_H)), K(S(KC_I)), K(S(KC_J)), K(S(KC_K)), K(S(KC_L)), K(S(KC_M)), K(S(KC_N)), K(S(KC_O)),
+    K(S(KC_P)), K(S(KC_Q)), K(S(KC_R)), K(S(KC_S)), K(S(KC_T)), K(S(KC_U)), K(S(KC_V)), K(S(KC_W)),
+    K(S(KC_X)), K(S(KC_Y)), K(S(KC_Z)), K(KC_RBRC), K(KC_JYEN), K(KC_BSLS), K(KC_EQL), K(S(KC_RO)),
+    K(S(KC_LBRC)), K(KC_A), K(KC_B), K(KC_C), K(KC_D), K(KC_E), K(KC_F), K(KC_G),
+    K(KC_H), K(KC_I), K(KC_J), K(KC_K), K(KC_L), K(KC_M), K(KC_N), K(KC_O),
+    K(KC_P), K(KC_Q), K(KC_R), K(KC_S), K(KC_T), K(KC_U), K(KC_V), K(KC_W),
+    K(KC_X), K(KC_Y), K(KC_Z), K(S(KC_RBRC)), K(S(KC_JYEN)), K(S(KC_BSLS)), K(S(KC_EQL)), K(KC_DEL),
+};
+#endif
+
+// Only the compiled in layouts have a table
+static const uint8_t *const send_string_layouts[SS_LAYOUT_COUNT] = {
+    [SS_QWERTY] = ss_layout_qwerty,
+#if SS_LAYOUT_ENABLED(SS_COLEMAK)
+    [SS_COLEMAK] = ss_layout_colemak,
+#endif
+#if SS_LAYOUT_ENABLED(SS_DVORAK)
+    [SS_DVORAK] = ss_layout_dvorak,
+#endif
+#if SS_LAYOUT_ENABLED(SS_AZERTY)
+    [SS_AZERTY] = ss_layout_azerty,
+#endif
+#if SS_LAYOUT_ENABLED(SS_JIS)
+    [SS_JIS] = ss_layout_jis,
+#endif
+};
+
+static uint8_t layout = SS_LAYOUT_COUNT;
+
+static bool send_string_layout_enabled(uint8_t l) {
+    return l < SS_LAYOUT_COUNT && send_string_layouts[l];
+}
+
+bool set_send_string_layout(uint8_t new_layout) {
+    if (!send_string_layout_enabled(new_layout)) {
+        return false;
+    }
+    layout = new_layout;
+    eeprom_update_byte(EECONFIG_SEND_STRING_LAYOUT, layout);
+    return true;
+}
+
+uint8_t get_send_string_layout(void) {
+    if (layout == SS_LAYOUT_COUNT) {
+        layout = eeprom_read_byte(EECONFIG_SEND_STRING_LAYOUT);
+        // never stored, or by a build with other layouts
+        if (!send_string_layout_enabled(layout)) {
+            layout = SEND_STRING_LAYOUT;
+        }
+    }
+    return layout;
+}
+
+uint8_t send_string_layout_char(uint8_t ascii_code) {
+    return pgm_read_byte(&send_string_layouts[get_send_string_layout()][ascii_code & 0x7F]);
+}
+
+uint8_t send_string_layout_key(uint8_t packed) {
+    uint8_t key = packed & SS_KEY_MASK;
+    switch (key) {
+        case KC_F1: return KC_DEL;
+        case KC_F2: return KC_NUBS;
+        case KC_F3: return KC_RO;
+        case KC_F4: return KC_JYEN;
+    }
+    return key;
+}
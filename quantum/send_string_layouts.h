@@ -0,0 +1,76 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEND_STRING_LAYOUTS_H
+#define SEND_STRING_LAYOUTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "progmem.h"
+#include "keycode.h"
+
+// Host keyboard layouts send_string can type on
+#define SS_QWERTY  0
+#define SS_COLEMAK 1
+#define SS_DVORAK  2
+#define SS_AZERTY  3 // French
+#define SS_JIS     4
+#define SS_LAYOUT_COUNT 5
+
+#ifndef SEND_STRING_LAYOUT
+#ifdef JIS_KEYCODE
+#define SEND_STRING_LAYOUT SS_JIS
+#else
+#define SEND_STRING_LAYOUT SS_QWERTY
+#endif
+#endif
+
+// Layouts compiled in besides QWERTY and SEND_STRING_LAYOUT, which always
+// are. Each takes 128 bytes of flash, e.g.
+// #define SEND_STRING_LAYOUTS (SS_LAYOUT_BIT(SS_DVORAK) | SS_LAYOUT_BIT(SS_COLEMAK))
+#define SS_LAYOUT_BIT(layout) (1 << (layout))
+#ifndef SEND_STRING_LAYOUTS
+#define SEND_STRING_LAYOUTS 0
+#endif
+#define SS_LAYOUT_ENABLED(layout) \
+    ((SEND_STRING_LAYOUTS | SS_LAYOUT_BIT(SS_QWERTY) | SS_LAYOUT_BIT(SEND_STRING_LAYOUT)) & SS_LAYOUT_BIT(layout))
+
+// Every character of a layout is one byte: the key in the low six bits,
+// and whether shift and AltGr are held while it is tapped in the top two.
+// The few keys from 0x40 up that are needed take the places of F1-F4,
+// which a string never types.
+#define SS_SHIFT    0x40
+#define SS_ALGR     0x80
+#define SS_KEY_MASK 0x3F
+
+#define SS_KEY(kc) ((kc) == KC_DEL ? KC_F1 : \
+                    (kc) == KC_NUBS ? KC_F2 : \
+                    (kc) == KC_RO ? KC_F3 : \
+                    (kc) == KC_JYEN ? KC_F4 : (kc))
+// Packs a keycode like S(KC_1) or ALGR(KC_2) into one byte of a layout
+#define SS_PACK(code) (SS_KEY((code) & 0xFF) | \
+                       ((code) & QK_LSFT ? SS_SHIFT : 0) | \
+                       (((code) & QK_RALT) == QK_RALT ? SS_ALGR : 0))
+
+// Selects the layout of the host and stores it in the EEPROM, unless it
+// is not compiled in
+bool set_send_string_layout(uint8_t layout);
+uint8_t get_send_string_layout(void);
+
+// The packed byte of the character in the current layout, 0 if it has none
+uint8_t send_string_layout_char(uint8_t ascii_code);
+// The key of a packed byte
+uint8_t send_string_layout_key(uint8_t packed);
+
+#endif
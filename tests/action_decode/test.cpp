@@ -0,0 +1,172 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "quantum.h"
+}
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_A, KC_B}, {KC_C, KC_D}},
+};
+
+static uint16_t test_keycode;
+
+extern "C" uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key) {
+    return test_keycode;
+}
+
+extern "C" uint16_t keymap_function_id_to_action(uint16_t function_id) {
+    return function_id ^ 0x5A5A;
+}
+
+namespace {
+
+// action_for_key() as it was before the decode tables
+action_t reference_action_for_keycode(uint16_t keycode) {
+    keycode = keycode_config(keycode);
+
+    action_t action;
+    uint8_t action_layer, when, mod;
+
+    switch (keycode) {
+        case KC_FN0 ... KC_FN31:
+            action.code = keymap_function_id_to_action(FN_INDEX(keycode));
+            break;
+        case KC_A ... KC_EXSEL:
+        case KC_LCTRL ... KC_RGUI:
+            action.code = ACTION_KEY(keycode);
+            break;
+        case KC_SYSTEM_POWER ... KC_SYSTEM_WAKE:
+            action.code = ACTION_USAGE_SYSTEM(KEYCODE2SYSTEM(keycode));
+            break;
+        case KC_AUDIO_MUTE ... KC_MEDIA_REWIND:
+            action.code = ACTION_USAGE_CONSUMER(KEYCODE2CONSUMER(keycode));
+            break;
+        case KC_MS_UP ... KC_MS_ACCEL2:
+            action.code = ACTION_MOUSEKEY(keycode);
+            break;
+        case KC_TRNS:
+            action.code = ACTION_TRANSPARENT;
+            break;
+        case QK_MODS ... QK_MODS_MAX:
+            action.code = ACTION_MODS_KEY(keycode >> 8, keycode & 0xFF);
+            break;
+        case QK_FUNCTION ... QK_FUNCTION_MAX:
+            action.code = keymap_function_id_to_action( (int)keycode & 0xFFF );
+            break;
+        case QK_MACRO ... QK_MACRO_MAX:
+            if (keycode & 0x800)
+                action.code = ACTION_MACRO_TAP(keycode & 0xFF);
+            else
+                action.code = ACTION_MACRO(keycode & 0xFF);
+            break;
+        case QK_LAYER_TAP ... QK_LAYER_TAP_MAX:
+            action.code = ACTION_LAYER_TAP_KEY((keycode >> 0x8) & 0xF, keycode & 0xFF);
+            break;
+        case QK_TO ... QK_TO_MAX:
+            when = (keycode >> 0x4) & 0x3;
+            action_layer = keycode & 0xF;
+            action.code = ACTION_LAYER_SET(action_layer, when);
+            break;
+        case QK_MOMENTARY ... QK_MOMENTARY_MAX:
+            action_layer = keycode & 0xFF;
+            action.code = ACTION_LAYER_MOMENTARY(action_layer);
+            break;
+        case QK_DEF_LAYER ... QK_DEF_LAYER_MAX:
+            action_layer = keycode & 0xFF;
+            action.code = ACTION_DEFAULT_LAYER_SET(action_layer);
+            break;
+        case QK_TOGGLE_LAYER ... QK_TOGGLE_LAYER_MAX:
+            action_layer = keycode & 0xFF;
+            action.code = ACTION_LAYER_TOGGLE(action_layer);
+            break;
+        case QK_ONE_SHOT_LAYER ... QK_ONE_SHOT_LAYER_MAX:
+            action_layer = keycode & 0xFF;
+            action.code = ACTION_LAYER_ONESHOT(action_layer);
+            break;
+        case QK_ONE_SHOT_MOD ... QK_ONE_SHOT_MOD_MAX:
+            mod = keycode & 0xFF;
+            action.code = ACTION_MODS_ONESHOT(mod);
+            break;
+        case QK_LAYER_TAP_TOGGLE ... QK_LAYER_TAP_TOGGLE_MAX:
+            action.code = ACTION_LAYER_TAP_TOGGLE(keycode & 0xFF);
+            break;
+        case QK_MOD_TAP ... QK_MOD_TAP_MAX:
+            action.code = ACTION_MODS_TAP_KEY((keycode >> 0x8) & 0x1F, keycode & 0xFF);
+            break;
+    #ifdef BACKLIGHT_ENABLE
+        case BL_0 ... BL_15:
+            action.code = ACTION_BACKLIGHT_LEVEL(keycode - BL_0);
+            break;
+        case BL_DEC:
+            action.code = ACTION_BACKLIGHT_DECREASE();
+            break;
+        case BL_INC:
+            action.code = ACTION_BACKLIGHT_INCREASE();
+            break;
+        case BL_TOGG:
+            action.code = ACTION_BACKLIGHT_TOGGLE();
+            break;
+        case BL_STEP:
+            action.code = ACTION_BACKLIGHT_STEP();
+            break;
+    #endif
+        default:
+            action.code = ACTION_NO;
+            break;
+    }
+    return action;
+}
+
+}
+
+TEST(ActionDecode, EveryKeycodeDecodesLikeTheSwitch) {
+    keypos_t key = {.col = 0, .row = 0};
+    uint32_t keycode = 0;
+    do {
+        test_keycode = keycode;
+        ASSERT_EQ(action_for_key(0, key).code, reference_action_for_keycode(keycode).code)
+            << "keycode 0x" << std::hex << keycode;
+    } while (++keycode <= 0xFFFF);
+}
+
+TEST(ActionDecode, EveryKeycodeDecodesLikeTheSwitchWithRemapping) {
+    keypos_t key = {.col = 0, .row = 0};
+    keymap_config.swap_control_capslock = true;
+    keymap_config.swap_lalt_lgui = true;
+    keymap_config.no_gui = true;
+    keymap_config.swap_grave_esc = true;
+    uint32_t keycode = 0;
+    do {
+        test_keycode = keycode;
+        ASSERT_EQ(action_for_key(0, key).code, reference_action_for_keycode(keycode).code)
+            << "keycode 0x" << std::hex << keycode;
+    } while (++keycode <= 0xFFFF);
+    keymap_config.raw = 0;
+}
+
+TEST(ActionDecode, BacklightKeycodesDecodeToBacklightActions) {
+    keypos_t key = {.col = 0, .row = 0};
+    test_keycode = BL_0 + 3;
+    EXPECT_EQ(action_for_key(0, key).code, ACTION_BACKLIGHT_LEVEL(3));
+    test_keycode = BL_TOGG;
+    EXPECT_EQ(action_for_key(0, key).code, ACTION_BACKLIGHT_TOGGLE());
+    test_keycode = BL_STEP;
+    EXPECT_EQ(action_for_key(0, key).code, ACTION_BACKLIGHT_STEP());
+    // the other keycodes sharing the high byte
+    test_keycode = BL_STEP + 1;
+    EXPECT_EQ(action_for_key(0, key).code, ACTION_NO);
+}
@@ -0,0 +1,181 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{M(0), M(1), KC_LSFT, KC_C}},
+};
+
+// the macros of M(0) and M(1), played on press
+static const macro_t *macros[2];
+
+const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt) {
+    return record->event.pressed ? macros[id] : MACRO_NONE;
+}
+
+const macro_t *action_get_submacro(uint8_t id) {
+    return id == 1 ? MACRO(T(C), END) : MACRO_NONE;
+}
+
+typedef std::vector<uint8_t> Keys;
+
+class ActionMacro : public TestFixture {
+public:
+    void tap(uint8_t col) {
+        press_key(col, 0);
+        run_one_scan_loop();
+        release_key(col, 0);
+        run_one_scan_loop();
+    }
+    void clear() {
+        recorder.clear();
+    }
+    // the keys of every report
+    std::vector<Keys> reports() {
+        std::vector<Keys> keys;
+        for (auto& report : recorder.reports) {
+            keys.push_back(report.keys);
+        }
+        return keys;
+    }
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(ActionMacro, MacroWithoutWaitsRunsAtOnce) {
+    macros[0] = MACRO(T(A), D(LSFT), T(B), U(LSFT), END);
+    press_key(0, 0);
+    keyboard_task();
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_A}, {}, {}, {KC_B}, {}, {} }));
+    EXPECT_EQ(recorder.reports[3].mods, MOD_BIT(KC_LSFT));
+    EXPECT_EQ(action_macro_running(), 0);
+    release_key(0, 0);
+    run_one_scan_loop();
+}
+
+TEST_F(ActionMacro, WaitDoesNotBlockTheKeyboard) {
+    macros[0] = MACRO(D(A), W(50), U(A), END);
+    press_key(0, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_A} }));
+    EXPECT_EQ(action_macro_running(), 1);
+
+    // other keys work meanwhile
+    tap(3);
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_A}, {KC_A, KC_C}, {KC_A} }));
+
+    idle_for(50);
+    EXPECT_EQ(recorder.reports.back().keys, Keys{});
+    EXPECT_EQ(recorder.reports.back().time - recorder.reports.front().time, 50);
+    EXPECT_EQ(action_macro_running(), 0);
+}
+
+TEST_F(ActionMacro, IntervalIsKeptBetweenCommands) {
+    macros[0] = MACRO(I(10), T(A), T(B), END);
+    tap(0);
+    idle_for(50);
+    auto& sent = recorder.reports;
+    ASSERT_EQ(sent.size(), 4);
+    for (size_t i = 1; i < sent.size(); i++) {
+        EXPECT_EQ(sent[i].time - sent[i - 1].time, 10);
+    }
+}
+
+TEST_F(ActionMacro, LoopRepeatsItsCommands) {
+    macros[0] = MACRO(LOOP(3), T(A), LOOP_END, T(B), END);
+    tap(0);
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_A}, {}, {KC_A}, {}, {KC_A}, {}, {KC_B}, {} }));
+}
+
+TEST_F(ActionMacro, LoopsNest) {
+    macros[0] = MACRO(LOOP(2), T(A), LOOP(2), T(B), LOOP_END, LOOP_END, END);
+    tap(0);
+    idle_for(5);
+    EXPECT_EQ(reports(), (std::vector<Keys>{
+        {KC_A}, {}, {KC_B}, {}, {KC_B}, {}, {KC_A}, {}, {KC_B}, {}, {KC_B}, {}
+    }));
+}
+
+TEST_F(ActionMacro, LoopOfZeroSkipsItsCommands) {
+    macros[0] = MACRO(LOOP(0), T(A), LOOP(2), T(B), LOOP_END, LOOP_END, T(C), END);
+    tap(0);
+    idle_for(5);
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_C}, {} }));
+}
+
+TEST_F(ActionMacro, IfModsChecksTheHeldMods) {
+    macros[0] = MACRO(IF_MODS(MOD_BIT(KC_LSFT)), T(A), END_IF, T(B), END);
+    tap(0);
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_B}, {} }));
+
+    clear();
+    press_key(2, 0);
+    run_one_scan_loop();
+    tap(0);
+    release_key(2, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {}, {KC_A}, {}, {KC_B}, {}, {} }));
+}
+
+TEST_F(ActionMacro, CallRunsASubmacro) {
+    macros[0] = MACRO(CALL(1), T(A), CALL(1), CALL(2), END);
+    tap(0);
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_C}, {}, {KC_A}, {}, {KC_C}, {} }));
+}
+
+TEST_F(ActionMacro, MacrosRunConcurrently) {
+    macros[0] = MACRO(I(10), T(A), T(A), END);
+    macros[1] = MACRO(I(10), T(B), T(B), END);
+    press_key(0, 0);
+    press_key(1, 0);
+    // a key a scan
+    run_one_scan_loop();
+    run_one_scan_loop();
+    EXPECT_EQ(action_macro_running(), 2);
+    idle_for(50);
+    release_key(0, 0);
+    release_key(1, 0);
+    run_one_scan_loop();
+    run_one_scan_loop();
+    EXPECT_EQ(reports(), (std::vector<Keys>{
+        {KC_A}, {KC_A, KC_B}, {KC_B}, {}, {KC_A}, {KC_A, KC_B}, {KC_B}, {}
+    }));
+}
+
+TEST_F(ActionMacro, LongMacrosAreSpreadOverScans) {
+    macros[0] = MACRO(LOOP(10), T(A), LOOP_END, END);
+    press_key(0, 0);
+    keyboard_task();
+    // T(A) is two commands, and each LOOP_END one more
+    EXPECT_LT(reports().size(), 20);
+    EXPECT_EQ(action_macro_running(), 1);
+    idle_for(10);
+    EXPECT_EQ(reports().size(), 20);
+    EXPECT_EQ(action_macro_running(), 0);
+    release_key(0, 0);
+    run_one_scan_loop();
+}
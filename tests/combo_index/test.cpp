@@ -0,0 +1,144 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_A, KC_B, KC_C, KC_G}, {KC_D, KC_E, KC_F, KC_H}},
+};
+
+// The combos are listed out of keycode order so that the index has to sort them
+const uint16_t PROGMEM ef_combo[] = {KC_F, KC_E, COMBO_END};
+const uint16_t PROGMEM ab_combo[] = {KC_A, KC_B, COMBO_END};
+const uint16_t PROGMEM cd_combo[] = {KC_D, KC_C, COMBO_END};
+
+extern "C" {
+combo_t key_combos[COMBO_COUNT] = {
+    COMBO(ef_combo, KC_TAB),
+    COMBO(ab_combo, KC_ESC),
+    COMBO(cd_combo, KC_ENT),
+};
+}
+
+class ComboIndex : public TestFixture {
+public:
+    ComboIndex() {
+        // A combo timer of 0 means that the combo is idle
+        set_time(1000);
+    }
+    testing::NiceMock<TestDriver> driver;
+};
+
+TEST_F(ComboIndex, EachComboFiresItsOwnKeycode) {
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    press_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ESC)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    press_key(2, 1);
+    run_one_scan_loop();
+    press_key(1, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_TAB)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(2, 1);
+    release_key(1, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    press_key(0, 1);
+    run_one_scan_loop();
+    press_key(2, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ENT)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(2, 0);
+    release_key(0, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ComboIndex, TappedComboKeyIsSentOnRelease) {
+    press_key(1, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(COMBO_TERM / 2);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(1, 1);
+    testing::InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_E)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ComboIndex, HeldComboKeyIsSentAfterTheComboTerm) {
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A))).Times(0);
+    idle_for(COMBO_TERM - 1);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    idle_for(3);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ComboIndex, OtherKeysAreNotDelayed) {
+    press_key(3, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_H)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(3, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
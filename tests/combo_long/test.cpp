@@ -0,0 +1,99 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_A, KC_B, KC_C, KC_D, KC_E, KC_F, KC_G, KC_H, KC_I, KC_J, KC_K, KC_L, KC_M}},
+};
+
+const uint16_t PROGMEM abcd_combo[] = {KC_A, KC_B, KC_C, KC_D, COMBO_END};
+const uint16_t PROGMEM eight_combo[] = {KC_E, KC_F, KC_G, KC_H, KC_I, KC_J, KC_K, KC_L, COMBO_END};
+// one key longer than COMBO_KEY_BUFFER_LENGTH
+const uint16_t PROGMEM nine_combo[] = {KC_E, KC_F, KC_G, KC_H, KC_I, KC_J, KC_K, KC_L, KC_M, COMBO_END};
+
+extern "C" {
+combo_t key_combos[COMBO_COUNT] = {
+    COMBO(abcd_combo, KC_ESC),
+    COMBO(eight_combo, KC_TAB),
+    COMBO(nine_combo, KC_ENT),
+};
+}
+
+class ComboLong : public TestFixture {
+public:
+    testing::NiceMock<TestDriver> driver;
+};
+
+TEST_F(ComboLong, ComboLongerThanAverageFitsTheIndex) {
+    for (uint8_t col = 0; col < 3; col++) {
+        press_key(col, 0);
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+        run_one_scan_loop();
+        testing::Mock::VerifyAndClearExpectations(&driver);
+    }
+
+    press_key(3, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ESC)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    for (uint8_t col = 0; col < 4; col++) {
+        release_key(col, 0);
+        run_one_scan_loop();
+    }
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ComboLong, EightKeysByDefault) {
+    EXPECT_EQ(COMBO_KEY_BUFFER_LENGTH, 8);
+    for (uint8_t col = 4; col < 11; col++) {
+        press_key(col, 0);
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+        run_one_scan_loop();
+        testing::Mock::VerifyAndClearExpectations(&driver);
+    }
+
+    // the longer combo is disabled, so nothing waits for its last key
+    press_key(11, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_TAB)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    press_key(12, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_TAB, KC_M)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(12, 0);
+    run_one_scan_loop();
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    for (uint8_t col = 4; col < 12; col++) {
+        release_key(col, 0);
+        run_one_scan_loop();
+    }
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
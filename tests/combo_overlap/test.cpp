@@ -0,0 +1,166 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+using testing::InSequence;
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {
+        {KC_A, KC_S, KC_D, KC_F, KC_G, KC_H},
+        {KC_I, KC_J, KC_K, KC_L, KC_M, KC_N},
+        {KC_O, KC_P, KC_Q, KC_R, KC_T, KC_U},
+        {KC_V, KC_W, KC_X, KC_Y, KC_Z, KC_1},
+    },
+};
+
+const uint16_t PROGMEM as_combo[] = {KC_A, KC_S, COMBO_END};
+const uint16_t PROGMEM asd_combo[] = {KC_A, KC_S, KC_D, COMBO_END};
+const uint16_t PROGMEM wide_combo[] = {
+    KC_I, KC_J, KC_K, KC_L, KC_M, KC_N,
+    KC_O, KC_P, KC_Q, KC_R, KC_T, KC_U,
+    KC_V, KC_W, KC_X, KC_Y, KC_Z, COMBO_END
+};
+
+extern "C" {
+combo_t key_combos[COMBO_COUNT] = {
+    COMBO(as_combo, KC_ESC),
+    COMBO(asd_combo, KC_TAB),
+    COMBO(wide_combo, KC_ENT),
+};
+}
+
+class ComboOverlap : public TestFixture {
+public:
+    ComboOverlap() {
+        set_time(1000);
+    }
+    testing::NiceMock<TestDriver> driver;
+
+    void tap_in_order(std::initializer_list<uint8_t> cols) {
+        for (auto col: cols) {
+            press_key(col, 0);
+            run_one_scan_loop();
+        }
+    }
+    void release_row(uint8_t row) {
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            release_key(col, row);
+            run_one_scan_loop();
+        }
+    }
+};
+
+TEST_F(ComboOverlap, LongerComboWins) {
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    tap_in_order({0, 1});
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_TAB)));
+    tap_in_order({2});
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    release_row(0);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ComboOverlap, ShorterComboIsSentAfterTheComboTerm) {
+    tap_in_order({1, 0});
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ESC)));
+    uint32_t waited = run_until_next_report();
+    // The term started with the first key, one scan earlier
+    EXPECT_GT(waited, COMBO_TERM - 3);
+    EXPECT_LE(waited, COMBO_TERM + 1);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    release_row(0);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ComboOverlap, ReleaseSendsTheShorterComboAtOnce) {
+    tap_in_order({0, 1});
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ESC)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    release_key(1, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ComboOverlap, OtherKeyIsSentAfterTheCombo) {
+    tap_in_order({0, 1});
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ESC)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ESC, KC_F)));
+    tap_in_order({3});
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_F)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    release_row(0);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ComboOverlap, KeysWithoutComboAreReplayedInOrder) {
+    // A and D are both in A+S+D, but make no combo on their own
+    tap_in_order({2, 0});
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_D)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_D, KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_D, KC_A, KC_G)));
+    tap_in_order({4});
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_D, KC_G)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_G)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    release_row(0);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ComboOverlap, ComboWithMoreThanSixteenKeys) {
+    // Every key below the first row except the last one
+    const uint8_t keys = MATRIX_COLS * (MATRIX_ROWS - 1) - 1;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    for (uint8_t k = 0; k < keys - 1; k++) {
+        press_key(k % MATRIX_COLS, 1 + k / MATRIX_COLS);
+        run_one_scan_loop();
+    }
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ENT)));
+    press_key((keys - 1) % MATRIX_COLS, 1 + (keys - 1) / MATRIX_COLS);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    for (uint8_t row = 1; row < MATRIX_ROWS; row++) {
+        release_row(row);
+    }
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
@@ -0,0 +1,270 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+
+extern "C" {
+#include "quantum.h"
+
+enum custom_keycodes {
+    DYNAMIC_MACRO_RANGE = SAFE_RANGE,
+};
+
+#include "dynamic_macro.h"
+
+bool process_record_user(uint16_t keycode, keyrecord_t *record) {
+    return process_record_dynamic_macro(keycode, record);
+}
+
+static uint32_t hook_layer_state;
+
+uint32_t layer_state_set_kb(uint32_t state) {
+    hook_layer_state = state;
+    return state;
+}
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+enum {
+    A, B, REC1, REC3, STOP, PLAY1, PLAY3, SPEED, FN
+};
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_A, KC_B, DYN_REC_START1, DYN_REC_START(3), DYN_REC_STOP, DYN_MACRO_PLAY1, DYN_MACRO_PLAY(3), DYN_MACRO_SPEED, MO(1)}},
+    // the macro keys are where A and B are, on a layer of their own
+    {{DYN_MACRO_PLAY1, DYN_REC_STOP, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS}},
+};
+
+typedef std::vector<uint8_t> Keys;
+
+class DynamicMacro : public TestFixture {
+public:
+    DynamicMacro() {
+        memset(dynamic_macro_length, 0, sizeof(dynamic_macro_length));
+        dynamic_macro_loaded = true;
+        dynamic_macro_speed = DYNAMIC_MACRO_SPEED_1X;
+    }
+    void tap(uint8_t col) {
+        press_key(col, 0);
+        run_one_scan_loop();
+        release_key(col, 0);
+        run_one_scan_loop();
+    }
+    void record(uint8_t rec, std::vector<uint8_t> cols) {
+        tap(rec);
+        for (uint8_t col : cols) {
+            tap(col);
+        }
+        tap(STOP);
+        clear();
+    }
+    std::vector<Keys> play(uint8_t play) {
+        clear();
+        tap(play);
+        idle_for(100);
+        return reports();
+    }
+    void clear() {
+        recorder.clear();
+    }
+    // the keys of every report that changes them
+    std::vector<Keys> reports() {
+        std::vector<Keys> keys;
+        for (auto& report : recorder.key_changes()) {
+            keys.push_back(report.keys);
+        }
+        return keys;
+    }
+    // and when they were sent
+    std::vector<uint32_t> times() {
+        std::vector<uint32_t> times;
+        for (auto& report : recorder.key_changes()) {
+            times.push_back(report.time);
+        }
+        return times;
+    }
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(DynamicMacro, RecordAndPlay) {
+    record(REC1, {A, B});
+    EXPECT_EQ(play(PLAY1), (std::vector<Keys>{ {KC_A}, {}, {KC_B}, {} }));
+    EXPECT_EQ(play(PLAY1), (std::vector<Keys>{ {KC_A}, {}, {KC_B}, {} }));
+}
+
+TEST_F(DynamicMacro, EventsAreCompact) {
+    tap(REC1);
+    for (uint8_t col : {A, B}) {
+        press_key(col, 0);
+        idle_for(80);
+        release_key(col, 0);
+        idle_for(150);
+    }
+    tap(STOP);
+    // one byte for the key and one for the time, at a normal typing pace
+    EXPECT_EQ(dynamic_macro_length[0], 4 * 2);
+}
+
+TEST_F(DynamicMacro, SlotsAreIndependent) {
+    record(REC1, {A});
+    record(REC3, {B});
+    EXPECT_EQ(play(PLAY1), (std::vector<Keys>{ {KC_A}, {} }));
+    EXPECT_EQ(play(PLAY3), (std::vector<Keys>{ {KC_B}, {} }));
+
+    // growing the first slot moves the third one out of the way
+    record(REC1, {B, A, B});
+    EXPECT_EQ(play(PLAY1), (std::vector<Keys>{ {KC_B}, {}, {KC_A}, {}, {KC_B}, {} }));
+    EXPECT_EQ(play(PLAY3), (std::vector<Keys>{ {KC_B}, {} }));
+}
+
+TEST_F(DynamicMacro, EventsThatDontFitAreDropped) {
+    record(REC3, {A});
+    std::vector<uint8_t> cols(DYNAMIC_MACRO_SIZE, B);
+    record(REC1, cols);
+    EXPECT_EQ(dynamic_macro_length[0] + dynamic_macro_length[2], DYNAMIC_MACRO_SIZE);
+    EXPECT_EQ(play(PLAY3), (std::vector<Keys>{ {KC_A}, {} }));
+}
+
+TEST_F(DynamicMacro, KeyboardKeepsRunningWhilePlaying) {
+    record(REC1, {A, B});
+    tap(PLAY1);
+    EXPECT_TRUE(reports().empty());
+    // one event a scan
+    run_one_scan_loop();
+    EXPECT_EQ(reports().size(), 1);
+    run_one_scan_loop();
+    EXPECT_EQ(reports().size(), 2);
+    idle_for(10);
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_A}, {}, {KC_B}, {} }));
+}
+
+TEST_F(DynamicMacro, MacrosAreLoadedFromEeprom) {
+    record(REC1, {A});
+    record(REC3, {B, A});
+    memset(dynamic_macro_length, 0, sizeof(dynamic_macro_length));
+    memset(dynamic_macro_buffer, 0, sizeof(dynamic_macro_buffer));
+    dynamic_macro_loaded = false;
+    EXPECT_EQ(play(PLAY3), (std::vector<Keys>{ {KC_B}, {}, {KC_A}, {} }));
+    EXPECT_EQ(play(PLAY1), (std::vector<Keys>{ {KC_A}, {} }));
+}
+
+TEST_F(DynamicMacro, InvalidEepromIsIgnored) {
+    record(REC1, {A});
+    memset(dynamic_macro_length, 0, sizeof(dynamic_macro_length));
+    eeprom_update_byte(EECONFIG_DYNAMIC_MACRO, 0xFF);
+    dynamic_macro_loaded = false;
+    EXPECT_EQ(play(PLAY1), (std::vector<Keys>{}));
+}
+
+TEST_F(DynamicMacro, PlaybackKeepsTheRecordedTiming) {
+    tap(REC1);
+    press_key(A, 0);
+    idle_for(60);
+    release_key(A, 0);
+    run_one_scan_loop();
+    uint32_t held = times()[1] - times()[0];
+    tap(STOP);
+
+    // in steps of DYNAMIC_MACRO_TIME_UNIT
+    play(PLAY1);
+    ASSERT_EQ(times().size(), 2);
+    EXPECT_NEAR(times()[1] - times()[0], held, DYNAMIC_MACRO_TIME_UNIT);
+
+    tap(SPEED);
+    play(PLAY1);
+    ASSERT_EQ(times().size(), 2);
+    EXPECT_NEAR(times()[1] - times()[0], held / 2, DYNAMIC_MACRO_TIME_UNIT);
+
+    tap(SPEED);
+    play(PLAY1);
+    ASSERT_EQ(times().size(), 2);
+    EXPECT_EQ(times()[1] - times()[0], 1);
+
+    tap(SPEED);
+    EXPECT_EQ(dynamic_macro_speed, DYNAMIC_MACRO_SPEED_1X);
+}
+
+TEST_F(DynamicMacro, PlaybackCanBeCancelled) {
+    tap(REC1);
+    press_key(A, 0);
+    idle_for(60);
+    release_key(A, 0);
+    run_one_scan_loop();
+    tap(B);
+    tap(STOP);
+    clear();
+
+    tap(PLAY1);
+    idle_for(10);
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_A} }));
+    tap(STOP);
+    EXPECT_FALSE(dynamic_macro_playing);
+    idle_for(100);
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_A}, {} }));
+}
+
+TEST_F(DynamicMacro, LayersOfTheUserAreLeftAlone) {
+    record(REC1, {A, B});
+
+    press_key(FN, 0);
+    run_one_scan_loop();
+    tap(A);
+    // the first event is on the layers of the macro, so it is still A
+    run_one_scan_loop();
+    release_key(FN, 0);
+    run_one_scan_loop();
+    idle_for(10);
+    EXPECT_FALSE(dynamic_macro_playing);
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_A}, {}, {KC_B}, {} }));
+    EXPECT_EQ(layer_state, 0);
+}
+
+TEST_F(DynamicMacro, CancellingOnlyReleasesTheKeysOfTheMacro) {
+    tap(REC1);
+    press_key(A, 0);
+    idle_for(60);
+    release_key(A, 0);
+    run_one_scan_loop();
+    tap(STOP);
+    clear();
+
+    tap(PLAY1);
+    idle_for(10);
+    press_key(B, 0);
+    run_one_scan_loop();
+    tap(STOP);
+    EXPECT_FALSE(dynamic_macro_playing);
+    release_key(B, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_A}, {KC_A, KC_B}, {KC_B}, {} }));
+}
+
+TEST_F(DynamicMacro, LayerHookEndsWithTheLayersOfTheUser) {
+    record(REC1, {FN, A});
+
+    tap(PLAY1);
+    // the macro presses its layer key
+    run_one_scan_loop();
+    EXPECT_EQ(dynamic_macro_play_layer_state, 1UL << 1);
+    EXPECT_EQ(hook_layer_state, 0);
+    EXPECT_EQ(layer_state, 0);
+    idle_for(10);
+    EXPECT_EQ(reports(), (std::vector<Keys>{ {KC_A}, {} }));
+}
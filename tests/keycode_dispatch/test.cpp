@@ -0,0 +1,105 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+
+extern "C" {
+LEADER_EXTERNS();
+
+static void dance_finished(qk_tap_dance_state_t *state, void *user_data) {
+    register_code(KC_C);
+    unregister_code(KC_C);
+}
+
+qk_tap_dance_action_t tap_dance_actions[] = {
+    [0] = ACTION_TAP_DANCE_FN(dance_finished),
+};
+}
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_A, KC_LEAD}, {TD(0), KC_B}},
+};
+
+class KeycodeDispatch : public TestFixture {
+public:
+    ~KeycodeDispatch() {
+        leading = false;
+    }
+    testing::NiceMock<TestDriver> driver;
+};
+
+TEST_F(KeycodeDispatch, OrdinaryKeysSkipTheProcessors) {
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    keyboard_task();
+    EXPECT_EQ(get_processor_visits(), 0);
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    keyboard_task();
+    EXPECT_EQ(get_processor_visits(), 0);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(KeycodeDispatch, LeaderSeesEveryKeyWhileLeading) {
+    press_key(1, 0);
+    keyboard_task();
+    EXPECT_EQ(get_processor_visits(), 1);
+    EXPECT_TRUE(leading);
+    release_key(1, 0);
+    keyboard_task();
+
+    // The leader consumes the key, so it is never reported
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    press_key(1, 1);
+    keyboard_task();
+    EXPECT_EQ(get_processor_visits(), 1);
+    EXPECT_EQ(leader_sequence[0], KC_B);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(1, 1);
+    keyboard_task();
+}
+
+// The tap dance state can't be reset, so this has to run last
+TEST_F(KeycodeDispatch, TapDanceSeesEveryKeyOnceUsed) {
+    press_key(0, 1);
+    keyboard_task();
+    EXPECT_EQ(get_processor_visits(), 1);
+    release_key(0, 1);
+    keyboard_task();
+    EXPECT_EQ(get_processor_visits(), 1);
+
+    // Interrupting the dance finishes it before the key is reported
+    testing::InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(testing::AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_C)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(testing::AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    press_key(0, 0);
+    keyboard_task();
+    EXPECT_EQ(get_processor_visits(), 1);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(0, 0);
+    keyboard_task();
+}
@@ -0,0 +1,131 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <chrono>
+#include <cstdio>
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+using testing::AnyNumber;
+
+#define ____ {{KC_TRNS, KC_TRNS}, {KC_TRNS, KC_TRNS}}
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_A, KC_B}, {KC_C, KC_D}},
+    ____, ____, ____, ____,
+    {{KC_X, KC_TRNS}, {KC_TRNS, KC_TRNS}},
+    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____,
+    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____,
+    ____, ____, ____, ____, ____, ____,
+};
+
+static int keymap_reads = 0;
+
+extern "C" uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key) {
+    keymap_reads++;
+    return pgm_read_word(&keymaps[layer][key.row][key.col]);
+}
+
+class LayerCache : public TestFixture {
+public:
+    ~LayerCache() {
+        layer_clear();
+    }
+    // Layer changes clear the keyboard, which sends reports
+    testing::NiceMock<TestDriver> driver;
+};
+
+TEST_F(LayerCache, LayerIsOnlyResolvedOncePerKey) {
+    default_layer_set(1UL << 0);
+    layer_or(0xFFFFFFFE);
+    keypos_t key = {.col = 1, .row = 0};
+    keymap_reads = 0;
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+    EXPECT_EQ(keymap_reads, 32);
+    keymap_reads = 0;
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+    EXPECT_EQ(keymap_reads, 0);
+}
+
+TEST_F(LayerCache, LayerChangesAreSeen) {
+    keypos_t key = {.col = 0, .row = 0};
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+    layer_on(5);
+    EXPECT_EQ(layer_switch_get_layer(key), 5);
+    layer_on(20);
+    EXPECT_EQ(layer_switch_get_layer(key), 5);
+    layer_off(5);
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+    default_layer_set(1UL << 5);
+    EXPECT_EQ(layer_switch_get_layer(key), 5);
+    default_layer_set(1UL << 0);
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+}
+
+TEST_F(LayerCache, DirectLayerStateWritesAreSeen) {
+    keypos_t key = {.col = 0, .row = 0};
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+    layer_state = 1UL << 5;
+    EXPECT_EQ(layer_switch_get_layer(key), 5);
+    layer_state = 0;
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+}
+
+TEST_F(LayerCache, KeyPressUsesTheCachedLayer) {
+    layer_on(5);
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_X)));
+    keyboard_task();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+namespace {
+double ns_per_lookup(uint32_t layers, bool cached) {
+    const int lookups = 100000;
+    keypos_t key = {.col = 1, .row = 1};
+    layer_clear();
+    layer_or(layers);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < lookups; i++) {
+        if (!cached) {
+            layer_cache_clear();
+        }
+        EXPECT_EQ(layer_switch_get_layer(key), 0);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / lookups;
+}
+}
+
+TEST_F(LayerCache, Benchmark) {
+    const struct {
+        int count;
+        uint32_t layers;
+    } keymaps[] = {{4, 0xE}, {16, 0xFFFE}, {32, 0xFFFFFFFE}};
+    for (auto& k: keymaps) {
+        double walk = ns_per_lookup(k.layers, false);
+        double cached = ns_per_lookup(k.layers, true);
+        printf("%2d layers: walk %6.1f ns, cached %6.1f ns per lookup\n", k.count, walk, cached);
+    }
+}
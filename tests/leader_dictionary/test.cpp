@@ -0,0 +1,132 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+using testing::InSequence;
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_LEAD, KC_A, KC_S, KC_D, KC_F}, {KC_B, KC_C, KC_E, KC_Z, KC_X}},
+};
+
+// Not in order, so that the dictionary has to be sorted
+const leader_seq_t PROGMEM leader_dictionary[LEADER_DICTIONARY_SIZE] = {
+    LEADER_SEQ(KC_3, KC_A, KC_S, KC_D),
+    LEADER_SEQ(KC_1, KC_F),
+    LEADER_SEQ_ACTION(KC_A, KC_B, KC_C, KC_D, KC_E, KC_F),
+    LEADER_SEQ(KC_2, KC_A, KC_S),
+};
+
+static uint8_t leader_events = 0;
+static uint8_t last_leader_event = 0xFF;
+
+extern "C" void process_leader_event(uint8_t index) {
+    leader_events++;
+    last_leader_event = index;
+}
+
+class LeaderDictionary : public TestFixture {
+public:
+    testing::NiceMock<TestDriver> driver;
+
+    void tap(uint8_t col, uint8_t row) {
+        press_key(col, row);
+        run_one_scan_loop();
+        release_key(col, row);
+        run_one_scan_loop();
+    }
+};
+
+TEST_F(LeaderDictionary, UniqueSequenceIsSentAtOnce) {
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    tap(0, 0);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_1)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    tap(4, 0);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_FALSE(process_leader_sees_all_keys());
+}
+
+TEST_F(LeaderDictionary, LongerSequenceIsSentAtItsLastKey) {
+    tap(0, 0);
+    tap(1, 0);
+    tap(2, 0);
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_3)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    tap(3, 0);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(LeaderDictionary, PrefixSequenceIsSentAfterTheTimeout) {
+    uint16_t start = timer_read();
+    tap(0, 0);
+    tap(1, 0);
+    tap(2, 0);
+    EXPECT_TRUE(process_leader_sees_all_keys());
+
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_2)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_until_next_report();
+    EXPECT_GE(timer_elapsed(start), LEADER_TIMEOUT);
+    EXPECT_LE(timer_elapsed(start), LEADER_TIMEOUT + 2);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_FALSE(process_leader_sees_all_keys());
+}
+
+TEST_F(LeaderDictionary, SequenceLongerThanFiveKeys) {
+    tap(0, 0);
+    tap(1, 0);
+    tap(0, 1);
+    tap(1, 1);
+    tap(3, 0);
+    tap(2, 1);
+    EXPECT_EQ(leader_events, 0);
+    tap(4, 0);
+    EXPECT_EQ(leader_events, 1);
+    EXPECT_EQ(last_leader_event, 2);
+    EXPECT_FALSE(process_leader_sees_all_keys());
+}
+
+TEST_F(LeaderDictionary, UnknownSequenceEndsAfterTheTimeout) {
+    // Only the releases of the swallowed keys get through
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(testing::AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(testing::Not(KeyboardReport()))).Times(0);
+    tap(0, 0);
+    tap(3, 1);
+    tap(4, 0);
+    idle_for(LEADER_TIMEOUT);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_FALSE(process_leader_sees_all_keys());
+
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_F)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    tap(4, 0);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
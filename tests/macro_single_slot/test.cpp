@@ -0,0 +1,79 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+
+enum custom_keycodes {
+    DYNAMIC_MACRO_RANGE = SAFE_RANGE,
+};
+
+#include "dynamic_macro.h"
+
+bool process_record_user(uint16_t keycode, keyrecord_t *record) {
+    return process_record_dynamic_macro(keycode, record);
+}
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+
+enum {
+    A, REC1, STOP, PLAY1, SPEED
+};
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_A, DYN_REC_START1, DYN_REC_STOP, DYN_MACRO_PLAY1, DYN_MACRO_SPEED}},
+};
+
+class MacroSingleSlot : public TestFixture {
+public:
+    void tap(uint8_t col) {
+        press_key(col, 0);
+        run_one_scan_loop();
+        release_key(col, 0);
+        run_one_scan_loop();
+    }
+    testing::NiceMock<TestDriver> driver;
+};
+
+TEST_F(MacroSingleSlot, SpeedKeyIsNotAPlayKey) {
+    EXPECT_NE(DYN_MACRO_SPEED, DYN_MACRO_PLAY1);
+    EXPECT_NE(DYN_MACRO_SPEED, DYN_MACRO_PLAY2);
+    EXPECT_EQ(dynamic_macro_play_slot(DYN_MACRO_PLAY2), -1);
+    EXPECT_EQ(dynamic_macro_rec_slot(DYN_REC_START2), -1);
+
+    tap(REC1);
+    tap(A);
+    tap(STOP);
+
+    uint8_t speed = dynamic_macro_speed;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    tap(SPEED);
+    idle_for(10);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_NE(dynamic_macro_speed, speed);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    tap(PLAY1);
+    idle_for(10);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
@@ -0,0 +1,183 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+using testing::AnyNumber;
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+	[0] = {
+	    {KC_A, KC_B,  KC_C, KC_NO},
+	    {KC_E, KC_NO, KC_G, KC_H},
+	    {KC_I, KC_J,  KC_K, KC_L},
+	    {KC_NO, KC_N, KC_O, KC_P}
+	},
+};
+
+namespace {
+
+struct Event {
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+    bool operator==(const Event& other) const {
+        return row == other.row && col == other.col && pressed == other.pressed;
+    }
+};
+
+std::ostream& operator<<(std::ostream& stream, const Event& e) {
+    return stream << "(" << (int)e.row << "," << (int)e.col << (e.pressed ? " down)" : " up)");
+}
+
+std::vector<Event> events;
+
+// The ghost detection as it was done before the real key masks, reading
+// the keymap for every column of every row.
+struct ReferenceGhost {
+    matrix_row_t matrix[MATRIX_ROWS] = {};
+    matrix_row_t prev[MATRIX_ROWS] = {};
+    int ghosted = 0;
+
+    matrix_row_t get_real_keys(uint8_t row, matrix_row_t rowdata) {
+        matrix_row_t out = 0;
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            if (pgm_read_byte(&keymaps[0][row][col]) && (rowdata & (1<<col))) {
+                out |= 1<<col;
+            }
+        }
+        return out;
+    }
+
+    bool popcount_more_than_one(matrix_row_t rowdata) {
+        rowdata &= rowdata-1;
+        return rowdata;
+    }
+
+    bool has_ghost_in_row(uint8_t row, matrix_row_t rowdata) {
+        rowdata = get_real_keys(row, rowdata);
+        if ((popcount_more_than_one(rowdata)) == 0) {
+            return false;
+        }
+        for (uint8_t i=0; i < MATRIX_ROWS; i++) {
+            if (i != row && popcount_more_than_one(get_real_keys(i, matrix[i]) & rowdata)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void task(std::vector<Event>& out) {
+        for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+            matrix_row_t change = matrix[r] ^ prev[r];
+            if (change) {
+                if (has_ghost_in_row(r, matrix[r])) {
+                    ghosted++;
+                    continue;
+                }
+                for (uint8_t c = 0; c < MATRIX_COLS; c++) {
+                    if (change & ((matrix_row_t)1<<c)) {
+                        out.push_back({r, c, (bool)(matrix[r] & ((matrix_row_t)1<<c))});
+                        prev[r] ^= ((matrix_row_t)1<<c);
+                        return;
+                    }
+                }
+            }
+        }
+    }
+};
+
+}
+
+extern "C" bool process_record_user(uint16_t keycode, keyrecord_t *record) {
+    events.push_back({record->event.key.row, record->event.key.col, record->event.pressed});
+    return true;
+}
+
+class MatrixGhost : public TestFixture {};
+
+TEST_F(MatrixGhost, GhostedRowIsHeldBack) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    // Two real keys on each of two rows, sharing two columns
+    press_key(0, 0);
+    press_key(2, 0);
+    for (int i = 0; i < 4; i++) {
+        keyboard_task();
+    }
+    events.clear();
+    press_key(0, 2);
+    press_key(2, 2);
+    for (int i = 0; i < 4; i++) {
+        keyboard_task();
+    }
+    EXPECT_TRUE(events.empty());
+    // The blank KC_NO on row 3 doesn't cause a ghost
+    press_key(1, 3);
+    press_key(0, 3);
+    for (int i = 0; i < 4; i++) {
+        keyboard_task();
+    }
+    EXPECT_EQ(events, (std::vector<Event>{{3, 0, true}, {3, 1, true}}));
+    events.clear();
+}
+
+TEST_F(MatrixGhost, SameDecisionsAsReferenceOnRandomMatrices) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    std::mt19937 rng(42);
+    ReferenceGhost reference;
+    std::vector<Event> expected;
+    events.clear();
+    for (int step = 0; step < 2000; step++) {
+        // Flip up to three random keys, and sometimes clear everything
+        if (rng() % 16 == 0) {
+            clear_all_keys();
+            memset(reference.matrix, 0, sizeof(reference.matrix));
+        }
+        for (unsigned i = rng() % 4; i > 0; i--) {
+            uint8_t row = rng() % MATRIX_ROWS;
+            uint8_t col = rng() % MATRIX_COLS;
+            matrix_row_t bit = (matrix_row_t)1 << col;
+            if (reference.matrix[row] & bit) {
+                release_key(col, row);
+            } else {
+                press_key(col, row);
+            }
+            reference.matrix[row] ^= bit;
+        }
+        for (int i = 0; i < 3; i++) {
+            keyboard_task();
+            reference.task(expected);
+        }
+    }
+    EXPECT_GT(expected.size(), 1000u);
+    EXPECT_GT(reference.ghosted, 100);
+    EXPECT_EQ(events, expected);
+    // Let the fixture release the keys from a known state
+    clear_all_keys();
+    events.clear();
+}
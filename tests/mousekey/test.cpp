@@ -0,0 +1,185 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <cmath>
+#include <vector>
+
+extern "C" {
+#include "quantum.h"
+#include "mousekey.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+using testing::Invoke;
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_MS_RIGHT, KC_MS_DOWN, KC_MS_WH_UP, KC_MS_ACCEL2}},
+};
+
+static const uint8_t curve[] = MOUSEKEY_CURVE;
+static const size_t curve_len = sizeof(curve);
+
+/* Units moved t ms after the initial delay, with the speed given by
+ * the curve, integrated in small steps.
+ */
+static double ideal_distance(double t, double unit, double time_to_max) {
+    const double ramp = time_to_max * MOUSEKEY_INTERVAL;
+    const double h = 0.01;
+    double d = 0;
+    for (double x = h / 2; x < t; x += h) {
+        double c = curve[curve_len - 1];
+        if (x < ramp) {
+            double pos = x / ramp * (curve_len - 1);
+            size_t i = (size_t)pos;
+            c = curve[i] + (curve[i + 1] - curve[i]) * (pos - i);
+        }
+        double speed = unit * c / 255 / MOUSEKEY_INTERVAL;
+        d += std::max(speed, 1.0 / MOUSEKEY_INTERVAL) * h;
+    }
+    return d;
+}
+
+struct MouseReport {
+    uint32_t time;
+    int8_t x, y, v;
+};
+
+class Mousekey : public TestFixture {
+public:
+    Mousekey() {
+        ON_CALL(driver, send_mouse_mock(_)).WillByDefault(Invoke([this](report_mouse_t& report) {
+            reports.push_back(MouseReport{timer_read32(), report.x, report.y, report.v});
+        }));
+    }
+    ~Mousekey() {
+        mousekey_clear();
+    }
+    // hold the keys for ms, returns when the first step was sent
+    uint32_t hold(std::vector<uint8_t> cols, uint32_t ms) {
+        for (uint8_t col : cols) {
+            press_key(col, 0);
+            run_one_scan_loop();
+        }
+        uint32_t start = 0;
+        for (auto& r : reports) {
+            if (r.x || r.y || r.v) {
+                start = r.time;
+                break;
+            }
+        }
+        while (timer_read32() - start < ms) {
+            run_one_scan_loop();
+        }
+        for (auto col = cols.rbegin(); col != cols.rend(); ++col) {
+            release_key(*col, 0);
+            run_one_scan_loop();
+        }
+        return start;
+    }
+    int total_x() {
+        int x = 0;
+        for (auto& r : reports) x += r.x;
+        return x;
+    }
+    int total_y() {
+        int y = 0;
+        for (auto& r : reports) y += r.y;
+        return y;
+    }
+    // when the last motion was sent
+    uint32_t last_motion() {
+        uint32_t last = 0;
+        for (auto& r : reports) {
+            if (r.x || r.y || r.v) last = r.time;
+        }
+        return last;
+    }
+    testing::NiceMock<TestDriver> driver;
+    std::vector<MouseReport> reports;
+};
+
+TEST_F(Mousekey, DistanceFollowsTheCurve) {
+    uint32_t start = hold({0}, 1500);
+    double t = last_motion() - start - MOUSEKEY_DELAY;
+    double ideal = MOUSEKEY_MOVE_DELTA +
+        ideal_distance(t, MOUSEKEY_MOVE_DELTA * MOUSEKEY_MAX_SPEED, MOUSEKEY_TIME_TO_MAX);
+    EXPECT_NEAR(total_x(), ideal, 2);
+    EXPECT_EQ(total_y(), 0);
+}
+
+TEST_F(Mousekey, DiagonalDistanceIsScaled) {
+    uint32_t start = hold({0, 1}, 1000);
+    // the second key gets no step of its own
+    double t = last_motion() - start - MOUSEKEY_DELAY;
+    double ideal = ideal_distance(t, MOUSEKEY_MOVE_DELTA * MOUSEKEY_MAX_SPEED, MOUSEKEY_TIME_TO_MAX) / std::sqrt(2);
+    EXPECT_NEAR(total_x(), MOUSEKEY_MOVE_DELTA + ideal, 2);
+    EXPECT_NEAR(total_y(), ideal, 2);
+}
+
+TEST_F(Mousekey, ConstantSpeedWithAccel) {
+    uint32_t start = hold({3, 0}, 500);
+    double t = last_motion() - start - MOUSEKEY_DELAY;
+    double speed = (double)MOUSEKEY_MOVE_DELTA * MOUSEKEY_MAX_SPEED / MOUSEKEY_INTERVAL;
+    EXPECT_NEAR(total_x(), MOUSEKEY_MOVE_DELTA + speed * t, 2);
+}
+
+TEST_F(Mousekey, ReportsAreSpacedByTheReportInterval) {
+    hold({0}, 1500);
+    ASSERT_GT(reports.size(), 2);
+    EXPECT_EQ(reports[0].x, MOUSEKEY_MOVE_DELTA);
+    for (size_t i = 2; i < reports.size(); i++) {
+        if (!reports[i].x) continue;
+        EXPECT_GE(reports[i].time - reports[i - 1].time, MOUSEKEY_REPORT_INTERVAL);
+    }
+}
+
+TEST_F(Mousekey, SlowMotionMovesAUnitAtATime) {
+    hold({0}, MOUSEKEY_DELAY + 50);
+    // a unit at a time at first, instead of nothing and then a jump
+    for (size_t i = 1; i < reports.size(); i++) {
+        EXPECT_LE(reports[i].x, 1);
+    }
+    EXPECT_GE(total_x(), MOUSEKEY_MOVE_DELTA + 50 / MOUSEKEY_INTERVAL);
+}
+
+TEST_F(Mousekey, WheelAccumulates) {
+    uint32_t start = hold({2}, 1000);
+    int v = 0;
+    for (auto& r : reports) v += r.v;
+    double t = last_motion() - start - MOUSEKEY_DELAY;
+    double ideal = MOUSEKEY_WHEEL_DELTA +
+        ideal_distance(t, MOUSEKEY_WHEEL_DELTA * MOUSEKEY_WHEEL_MAX_SPEED, MOUSEKEY_WHEEL_TIME_TO_MAX);
+    EXPECT_NEAR(v, ideal, 2);
+}
+
+TEST_F(Mousekey, SpeedHoldsOnLongPresses) {
+    uint32_t start = hold({0}, 70000);
+    // the steady speed must not drop back once a minute has passed
+    auto distance = [&](uint32_t from, uint32_t to) {
+        int x = 0;
+        for (auto& r : reports) {
+            if (r.time - start >= from && r.time - start < to) x += r.x;
+        }
+        return x;
+    };
+    int steady = distance(5000, 6000);
+    EXPECT_GT(steady, 1000 / MOUSEKEY_INTERVAL);
+    EXPECT_NEAR(distance(68000, 69000), steady, 2);
+}
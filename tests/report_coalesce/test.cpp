@@ -0,0 +1,180 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+#include <tuple>
+#include <vector>
+
+using testing::_;
+
+
+enum {
+    COPY = SAFE_RANGE,
+    TAP_X,
+};
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{COPY, TAP_X}, {KC_A, KC_B}},
+};
+
+extern "C" bool process_record_user(uint16_t keycode, keyrecord_t *record) {
+    switch (keycode) {
+    case COPY:
+        if (record->event.pressed) {
+            register_code16(LCTL(LSFT(KC_C)));
+        } else {
+            unregister_code16(LCTL(LSFT(KC_C)));
+        }
+        return false;
+    case TAP_X:
+        if (record->event.pressed) {
+            register_code(KC_LSFT);
+            register_code(KC_X);
+            unregister_code(KC_X);
+            unregister_code(KC_LSFT);
+        }
+        return false;
+    }
+    return true;
+}
+
+typedef std::tuple<uint8_t, bool, uint8_t> KeyEvent;
+
+static bool contains(const std::vector<uint8_t>& keys, uint8_t key) {
+    return std::find(keys.begin(), keys.end(), key) != keys.end();
+}
+
+// The presses and releases the host sees, with the modifiers held at the time
+static std::vector<KeyEvent> key_events(const std::vector<SentReport>& reports) {
+    std::vector<KeyEvent> events;
+    std::vector<uint8_t> held;
+    for (auto& report : reports) {
+        for (auto k : held) {
+            if (!contains(report.keys, k)) {
+                events.emplace_back(k, false, report.mods);
+            }
+        }
+        for (auto k : report.keys) {
+            if (!contains(held, k)) {
+                events.emplace_back(k, true, report.mods);
+            }
+        }
+        held = report.keys;
+    }
+    return events;
+}
+
+class ReportCoalesce : public TestFixture {
+public:
+    void expect_equivalent(const std::vector<SentReport>& uncoalesced) {
+        auto& sent = recorder.reports;
+        EXPECT_LE(sent.size(), uncoalesced.size());
+        EXPECT_EQ(key_events(sent), key_events(uncoalesced));
+        ASSERT_FALSE(sent.empty());
+        EXPECT_EQ(sent.back().mods, uncoalesced.back().mods);
+        EXPECT_EQ(sent.back().keys, uncoalesced.back().keys);
+    }
+
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(ReportCoalesce, ModsAreMergedBeforeTheKey) {
+    press_key(0, 0);
+    keyboard_task();
+    release_key(0, 0);
+    keyboard_task();
+    expect_equivalent({
+        {0x01, {}},
+        {0x03, {}},
+        {0x03, {KC_C}},
+        {0x03, {}},
+        {0x02, {}},
+        {0x00, {}},
+    });
+    EXPECT_EQ(recorder.reports.size(), 4);
+}
+
+TEST_F(ReportCoalesce, TapWithinOneEventIsNotLost) {
+    press_key(1, 0);
+    keyboard_task();
+    release_key(1, 0);
+    keyboard_task();
+    expect_equivalent({
+        {0x02, {}},
+        {0x02, {KC_X}},
+        {0x02, {}},
+        {0x00, {}},
+    });
+}
+
+TEST_F(ReportCoalesce, KeysChangedInOneScanAreMerged) {
+    press_key(0, 1);
+    press_key(1, 1);
+    keyboard_task();
+    release_key(0, 1);
+    release_key(1, 1);
+    keyboard_task();
+    expect_equivalent({
+        {0x00, {KC_A}},
+        {0x00, {KC_A, KC_B}},
+        {0x00, {KC_B}},
+        {0x00, {}},
+    });
+    EXPECT_EQ(recorder.reports.size(), 2);
+}
+
+TEST_F(ReportCoalesce, OtherReportsKeepTheirOrder) {
+    testing::InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_consumer_mock(AUDIO_MUTE));
+    add_key(KC_A);
+    send_keyboard_report();
+    host_consumer_send(AUDIO_MUTE);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    host_consumer_send(0);
+    del_key(KC_A);
+    send_keyboard_report();
+    host_keyboard_flush();
+}
+
+TEST_F(ReportCoalesce, ReportsWaitForTheNextFrame) {
+    host_keyboard_frame();
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    add_key(KC_A);
+    send_keyboard_report();
+    host_keyboard_flush();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    // The host has not polled the endpoint since the last report
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    del_key(KC_A);
+    send_keyboard_report();
+    host_keyboard_flush();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    host_keyboard_frame();
+    host_keyboard_flush();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
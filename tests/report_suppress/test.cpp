@@ -0,0 +1,77 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_A, KC_B}, {KC_C, KC_D}},
+};
+
+class ReportSuppress : public TestFixture {
+public:
+    testing::NiceMock<TestDriver> driver;
+};
+
+TEST_F(ReportSuppress, IdenticalReportsAreSentOnce) {
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    keyboard_task();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    uint16_t suppressed = host_keyboard_suppressed_reports();
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    send_keyboard_report();
+    send_keyboard_report();
+    EXPECT_EQ(host_keyboard_suppressed_reports(), suppressed + 2);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    keyboard_task();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ReportSuppress, ChangedReportsAreAllSent) {
+    testing::InSequence s;
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    keyboard_task();
+    press_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B)));
+    keyboard_task();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    keyboard_task();
+    release_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    keyboard_task();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ReportSuppress, NewDriverGetsTheFirstReport) {
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    send_keyboard_report();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
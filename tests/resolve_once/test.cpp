@@ -0,0 +1,103 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_A, KC_B}, {KC_C, KC_D}},
+    {{KC_TRNS, KC_TRNS}, {KC_TRNS, KC_X}},
+};
+
+// Every layer walk over a transparent key falls through layer 1 once
+static int layer_walks = 0;
+static int keymap_reads = 0;
+static int quantum_keycodes = 0;
+
+extern "C" uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key) {
+    uint16_t keycode = pgm_read_word(&keymaps[layer][key.row][key.col]);
+    keymap_reads++;
+    if (keycode == KC_TRNS) {
+        layer_walks++;
+    }
+    return keycode;
+}
+
+extern "C" bool process_record_user(uint16_t keycode, keyrecord_t *record) {
+    quantum_keycodes = keycode;
+    return true;
+}
+
+class ResolveOnce : public TestFixture {
+public:
+    ResolveOnce() {
+        layer_on(1);
+        layer_walks = 0;
+        keymap_reads = 0;
+    }
+    ~ResolveOnce() {
+        layer_clear();
+    }
+    testing::NiceMock<TestDriver> driver;
+};
+
+TEST_F(ResolveOnce, KeyPressWalksTheLayersOnce) {
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    keyboard_task();
+    EXPECT_EQ(layer_walks, 1);
+    EXPECT_EQ(quantum_keycodes, KC_A);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ResolveOnce, KeyReleaseUsesTheSourceLayer) {
+    press_key(1, 1);
+    keyboard_task();
+    layer_off(1);
+    keymap_reads = 0;
+    release_key(1, 1);
+    // Turning the layer off already reported the key as released
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    keyboard_task();
+    // The release only reads the keycode of layer 1, where the key was pressed
+    EXPECT_EQ(keymap_reads, 1);
+    EXPECT_EQ(quantum_keycodes, KC_X);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(ResolveOnce, EveryEventWalksTheLayersAtMostOnce) {
+    for (int i = 0; i < 21; i++) {
+        // The three keys that are transparent on layer 1
+        uint8_t col = i % 3 == 1;
+        uint8_t row = i % 3 == 2;
+        layer_walks = 0;
+        press_key(col, row);
+        keyboard_task();
+        EXPECT_EQ(layer_walks, 1);
+        layer_walks = 0;
+        release_key(col, row);
+        keyboard_task();
+        EXPECT_EQ(layer_walks, 0);
+    }
+}
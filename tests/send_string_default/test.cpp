@@ -0,0 +1,48 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+#include "eeprom.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_NO}},
+};
+
+class SendStringDefault : public TestFixture {
+public:
+    testing::NiceMock<TestDriver> driver;
+};
+
+// First, before the layout has been read from the EEPROM
+TEST_F(SendStringDefault, StoredLayoutThatIsNotCompiledInIsIgnored) {
+    eeprom_update_byte(EECONFIG_SEND_STRING_LAYOUT, SS_AZERTY);
+    EXPECT_EQ(get_send_string_layout(), SS_QWERTY);
+    EXPECT_EQ(send_string_layout_char('a'), KC_A);
+}
+
+TEST_F(SendStringDefault, OnlyQwertyIsCompiledIn) {
+    EXPECT_TRUE(set_send_string_layout(SS_QWERTY));
+    EXPECT_FALSE(set_send_string_layout(SS_DVORAK));
+    EXPECT_EQ(get_send_string_layout(), SS_QWERTY);
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_SEND_STRING_LAYOUT), SS_QWERTY);
+}
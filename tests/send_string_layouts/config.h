@@ -0,0 +1,25 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TESTS_SEND_STRING_LAYOUTS_CONFIG_H_
+#define TESTS_SEND_STRING_LAYOUTS_CONFIG_H_
+
+#define MATRIX_ROWS 1
+#define MATRIX_COLS 1
+
+#define TAPPING_TERM 200
+#define SEND_STRING_LAYOUTS (SS_LAYOUT_BIT(SS_COLEMAK) | SS_LAYOUT_BIT(SS_DVORAK) | \
+                             SS_LAYOUT_BIT(SS_AZERTY) | SS_LAYOUT_BIT(SS_JIS))
+
+#endif /* TESTS_SEND_STRING_LAYOUTS_CONFIG_H_ */
@@ -0,0 +1,98 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+
+extern "C" {
+#include "quantum.h"
+#include "eeprom.h"
+#include "keymap_extras/keymap_dvorak.h"
+#include "keymap_extras/keymap_french.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_NO}},
+};
+
+class SendStringLayouts : public TestFixture {
+public:
+    ~SendStringLayouts() {
+        set_send_string_layout(SS_QWERTY);
+    }
+
+    // Each tapped key with the mods it was tapped with, in the same form as
+    // the keycodes in keymap_extras
+    std::vector<uint16_t> tapped() {
+        std::vector<uint16_t> codes;
+        for (auto& report : recorder.taps()) {
+            uint16_t code = report.keys[0];
+            if (report.mods & MOD_BIT(KC_LSFT)) code |= QK_LSFT;
+            if (report.mods & MOD_BIT(KC_RALT)) code |= QK_RALT;
+            codes.push_back(code);
+        }
+        return codes;
+    }
+
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(SendStringLayouts, QwertyIsTheDefault) {
+    EXPECT_EQ(get_send_string_layout(), SS_QWERTY);
+    SEND_STRING("Hi!\n");
+    EXPECT_EQ(tapped(), std::vector<uint16_t>({S(KC_H), KC_I, S(KC_1), KC_ENT}));
+}
+
+TEST_F(SendStringLayouts, DvorakTapsTheKeysOfTheDvorakLayout) {
+    set_send_string_layout(SS_DVORAK);
+    SEND_STRING("qmk{}");
+    EXPECT_EQ(tapped(), std::vector<uint16_t>({DV_Q, DV_M, DV_K, DV_LCBR, DV_RCBR}));
+    EXPECT_EQ(tapped(), std::vector<uint16_t>({KC_X, KC_M, KC_V, S(KC_MINS), S(KC_EQL)}));
+}
+
+TEST_F(SendStringLayouts, AzertyUsesAltGr) {
+    set_send_string_layout(SS_AZERTY);
+    SEND_STRING("a@1<[");
+    EXPECT_EQ(tapped(), std::vector<uint16_t>({FR_A, FR_AT, FR_1, FR_LESS, FR_LBRC}));
+}
+
+TEST_F(SendStringLayouts, KeysAboveTheFunctionRowArePacked) {
+    set_send_string_layout(SS_JIS);
+    SEND_STRING("\\_|\x7f");
+    EXPECT_EQ(tapped(), std::vector<uint16_t>({KC_JYEN, S(KC_RO), S(KC_JYEN), KC_DEL}));
+}
+
+TEST_F(SendStringLayouts, ColemakMovesTheLetters) {
+    set_send_string_layout(SS_COLEMAK);
+    SEND_STRING("Fun;");
+    EXPECT_EQ(tapped(), std::vector<uint16_t>({S(KC_E), KC_I, KC_J, KC_P}));
+}
+
+TEST_F(SendStringLayouts, LayoutIsStoredInTheEeprom) {
+    EXPECT_TRUE(set_send_string_layout(SS_AZERTY));
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_SEND_STRING_LAYOUT), SS_AZERTY);
+    EXPECT_FALSE(set_send_string_layout(SS_LAYOUT_COUNT));
+    EXPECT_EQ(get_send_string_layout(), SS_AZERTY);
+}
+
+TEST_F(SendStringLayouts, UntypableCharactersAreSkipped) {
+    SEND_STRING("a\x01" "b");
+    EXPECT_EQ(tapped(), std::vector<uint16_t>({KC_A, KC_B}));
+}
@@ -0,0 +1,117 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_1, KC_B}},
+};
+
+class SendStringQueue : public TestFixture {
+public:
+    // What the report types on a US layout, for the keys used here
+    static std::string text_of(const SentReport& report) {
+        uint8_t key = report.keys[0];
+        bool shift = report.mods & MOD_BIT(KC_LSFT);
+        if (key >= KC_A && key <= KC_Z) return std::string(1, (shift ? 'A' : 'a') + key - KC_A);
+        if (key == KC_1) return shift ? "!" : "1";
+        if (key >= KC_2 && key <= KC_9) return std::string(1, '2' + key - KC_2);
+        if (key == KC_0) return "0";
+        return "?";
+    }
+
+    // Scans until the queue is empty, and returns the reports sent per scan
+    std::vector<unsigned> drain() {
+        std::vector<unsigned> per_scan;
+        while (send_string_queue_space() < SEND_STRING_QUEUE_SIZE) {
+            unsigned before = recorder.reports.size();
+            run_one_scan_loop();
+            per_scan.push_back(recorder.reports.size() - before);
+        }
+        return per_scan;
+    }
+
+    // the tapped keys, as text
+    std::string typed() {
+        std::string text;
+        for (auto& report : recorder.taps()) {
+            text += text_of(report);
+        }
+        return text;
+    }
+
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(SendStringQueue, ReturnsBeforeTyping) {
+    SEND_STRING("Hi!");
+    EXPECT_EQ(recorder.reports.size(), 0);
+    EXPECT_EQ(send_string_queue_space(), SEND_STRING_QUEUE_SIZE - 3);
+    std::vector<unsigned> per_scan = drain();
+    EXPECT_EQ(typed(), "Hi!");
+    EXPECT_EQ(per_scan, std::vector<unsigned>({4, 2, 4}));
+}
+
+TEST_F(SendStringQueue, SendsAFewReportsPerScan) {
+    SEND_STRING("abcdefg");
+    std::vector<unsigned> per_scan = drain();
+    EXPECT_EQ(typed(), "abcdefg");
+    for (unsigned n : per_scan) {
+        EXPECT_LE(n, SEND_STRING_REPORTS_PER_SCAN);
+    }
+    EXPECT_EQ(per_scan.size(), 4);
+}
+
+TEST_F(SendStringQueue, KeysAreScannedWhileTyping) {
+    SEND_STRING("aaaaaaaa");
+    run_one_scan_loop();
+    press_key(1, 0);
+    run_one_scan_loop();
+    // The key press went out while half of the string is still queued
+    EXPECT_EQ(typed(), "aaaab");
+    EXPECT_EQ(send_string_queue_space(), SEND_STRING_QUEUE_SIZE - 4);
+    release_key(1, 0);
+    drain();
+    run_one_scan_loop();
+}
+
+TEST_F(SendStringQueue, FullQueueTypesTheOldestRightAway) {
+    uint16_t stalls = send_string_stalls();
+    SEND_STRING("0123456789");
+    EXPECT_EQ(typed(), "01");
+    EXPECT_EQ(send_string_stalls() - stalls, 2);
+    EXPECT_EQ(send_string_queue_space(), 0);
+    drain();
+    EXPECT_EQ(typed(), "0123456789");
+}
+
+TEST_F(SendStringQueue, FlushTypesEverything) {
+    SEND_STRING("abc");
+    send_byte(0x2f);
+    send_string_flush();
+    EXPECT_EQ(typed(), "abc2f");
+    EXPECT_EQ(send_string_queue_space(), SEND_STRING_QUEUE_SIZE);
+}
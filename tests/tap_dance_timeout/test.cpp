@@ -0,0 +1,187 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+
+extern "C" {
+#include "quantum.h"
+#include "deferred_exec.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+using testing::Invoke;
+
+static uint32_t finished_at = 0;
+static uint32_t reset_at = 0;
+
+static void record_finished(qk_tap_dance_state_t *state, void *user_data) {
+    finished_at = timer_read32();
+}
+
+static void record_reset(qk_tap_dance_state_t *state, void *user_data) {
+    reset_at = timer_read32();
+}
+
+static qk_tap_dance_pair_t pair = {KC_B, KC_C};
+
+// What ACTION_TAP_DANCE_DOUBLE(KC_B, KC_C) and
+// ACTION_TAP_DANCE_FN_ADVANCED_TIME(NULL, record_finished, record_reset, 50)
+// make, those macros are C only
+extern "C" {
+qk_tap_dance_action_t tap_dance_actions[] = {
+    {{NULL, qk_tap_dance_pair_finished, qk_tap_dance_pair_reset}, {}, 0, &pair},
+    {{NULL, record_finished, record_reset}, {}, 50, NULL},
+};
+}
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{TD(0), TD(1)}},
+};
+
+class TapDanceTimeout : public TestFixture {
+public:
+    ~TapDanceTimeout() {
+        // Once the dances are over nothing waits on a timeout any more
+        EXPECT_EQ(deferred_exec_next(), UINT32_MAX);
+    }
+
+    // Taps the key, and returns the time the press was processed at
+    uint32_t tap(uint8_t col) {
+        uint32_t pressed_at = timer_read32();
+        press_key(col, 0);
+        run_one_scan_loop();
+        release_key(col, 0);
+        run_one_scan_loop();
+        return pressed_at;
+    }
+
+    testing::NiceMock<TestDriver> driver;
+};
+
+TEST_F(TapDanceTimeout, SingleTapFinishesOnceTheTermHasPassed) {
+    uint32_t pressed_at = tap(0);
+    uint32_t sent_at = 0;
+    // Finishing and resetting the dance also sends the report as it is
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(testing::AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B))).WillOnce(Invoke([&](report_keyboard_t&) {
+        sent_at = timer_read32();
+    }));
+    idle_for(TAPPING_TERM + 10);
+    EXPECT_EQ(sent_at - pressed_at, TAPPING_TERM + 1);
+}
+
+TEST_F(TapDanceTimeout, SecondTapRestartsTheTerm) {
+    uint32_t pressed_at = tap(0);
+    idle_for(TAPPING_TERM - 20);
+    pressed_at = tap(0);
+    uint32_t sent_at = 0;
+    // Finishing and resetting the dance also sends the report as it is
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(testing::AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_C))).WillOnce(Invoke([&](report_keyboard_t&) {
+        sent_at = timer_read32();
+    }));
+    idle_for(TAPPING_TERM + 10);
+    EXPECT_EQ(sent_at - pressed_at, TAPPING_TERM + 1);
+}
+
+TEST_F(TapDanceTimeout, DanceWithItsOwnTerm) {
+    uint32_t pressed_at = tap(1);
+    idle_for(100);
+    EXPECT_EQ(finished_at - pressed_at, 51);
+    EXPECT_EQ(reset_at, finished_at);
+}
+
+TEST_F(TapDanceTimeout, HeldDanceIsResetWhenReleased) {
+    uint32_t pressed_at = timer_read32();
+    press_key(1, 0);
+    run_one_scan_loop();
+    idle_for(100);
+    EXPECT_EQ(finished_at - pressed_at, 51);
+    EXPECT_LT(reset_at, finished_at);
+    release_key(1, 0);
+    uint32_t released_at = timer_read32();
+    run_one_scan_loop();
+    EXPECT_EQ(reset_at, released_at);
+}
+
+TEST_F(TapDanceTimeout, HeldDanceIsNotPolled) {
+    press_key(1, 0);
+    run_one_scan_loop();
+    idle_for(100);
+    EXPECT_NE(finished_at, 0);
+    // only the release is waited for
+    EXPECT_EQ(deferred_exec_next(), UINT32_MAX);
+    EXPECT_TRUE(process_tap_dance_sees_all_keys());
+    release_key(1, 0);
+    run_one_scan_loop();
+    EXPECT_FALSE(process_tap_dance_sees_all_keys());
+}
+
+TEST_F(TapDanceTimeout, OtherKeysAreOnlySeenWhileADanceGoesOn) {
+    EXPECT_FALSE(process_tap_dance_sees_all_keys());
+    tap(1);
+    EXPECT_TRUE(process_tap_dance_sees_all_keys());
+    idle_for(100);
+    EXPECT_FALSE(process_tap_dance_sees_all_keys());
+}
+
+TEST_F(TapDanceTimeout, HeldDanceStaysActiveBesideAnother) {
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(testing::AnyNumber());
+    press_key(0, 0);
+    run_one_scan_loop();
+    // interrupts the held dance, which is finished but can't be reset yet
+    uint32_t pressed_at = tap(1);
+    EXPECT_TRUE(process_tap_dance_sees_all_keys());
+    idle_for(100);
+    EXPECT_EQ(finished_at - pressed_at, 51);
+    EXPECT_TRUE(process_tap_dance_sees_all_keys());
+    // reset once its own term is over
+    release_key(0, 0);
+    idle_for(TAPPING_TERM);
+    EXPECT_FALSE(process_tap_dance_sees_all_keys());
+}
+
+static uint32_t never_runs(uint32_t trigger_time, void *cb_arg) {
+    return 0;
+}
+
+TEST_F(TapDanceTimeout, DanceEndsAtOnceWithoutADeferredTask) {
+    std::vector<deferred_token> tokens;
+    deferred_token token;
+    while ((token = defer_exec(60000, never_runs, NULL)) != INVALID_DEFERRED_TOKEN) {
+        tokens.push_back(token);
+    }
+
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(testing::AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_FALSE(process_tap_dance_sees_all_keys());
+
+    for (deferred_token t : tokens) {
+        cancel_deferred_exec(t);
+    }
+}
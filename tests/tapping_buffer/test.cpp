@@ -0,0 +1,131 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "quantum.h"
+#include "action_tapping.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{MT(MOD_LSFT, KC_A), KC_B, KC_C}},
+};
+
+typedef std::pair<uint8_t, std::vector<uint8_t>> Report;
+
+class TappingBuffer : public TestFixture {
+public:
+    TappingBuffer() {
+        action_tapping_clear_buffer_stats();
+    }
+    void tap(uint8_t col) {
+        press_key(col, 0);
+        run_one_scan_loop();
+        release_key(col, 0);
+        run_one_scan_loop();
+    }
+    // mods and keys of every report sent
+    std::vector<Report> reports() {
+        std::vector<Report> sent;
+        for (auto& report : recorder.reports) {
+            sent.push_back(Report(report.mods, report.keys));
+        }
+        return sent;
+    }
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(TappingBuffer, EventsThatFitWaitForTheTappingTerm) {
+    press_key(0, 0);
+    run_one_scan_loop();
+    tap(1);
+    EXPECT_TRUE(recorder.reports.empty());
+    idle_for(TAPPING_TERM);
+    EXPECT_EQ(reports(), (std::vector<Report>{
+        Report(MOD_BIT(KC_LSFT), {}),
+        Report(MOD_BIT(KC_LSFT), {KC_B}), Report(MOD_BIT(KC_LSFT), {})
+    }));
+    EXPECT_EQ(action_tapping_buffer_peak(), 2);
+    EXPECT_EQ(action_tapping_buffer_overflows(), 0);
+
+    recorder.clear();
+    release_key(0, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(reports(), (std::vector<Report>{ Report(0, {}) }));
+}
+
+TEST_F(TappingBuffer, OverflowSettlesTheTapKeyAsAHold) {
+    press_key(0, 0);
+    run_one_scan_loop();
+    tap(1);
+    // the release of C doesn't fit any more
+    tap(2);
+    EXPECT_EQ(reports(), (std::vector<Report>{
+        Report(MOD_BIT(KC_LSFT), {}),
+        Report(MOD_BIT(KC_LSFT), {KC_B}), Report(MOD_BIT(KC_LSFT), {}),
+        Report(MOD_BIT(KC_LSFT), {KC_C}), Report(MOD_BIT(KC_LSFT), {})
+    }));
+    EXPECT_EQ(action_tapping_buffer_peak(), 3);
+    EXPECT_EQ(action_tapping_buffer_overflows(), 1);
+
+    recorder.clear();
+    release_key(0, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(reports(), (std::vector<Report>{ Report(0, {}) }));
+}
+
+TEST_F(TappingBuffer, EventsAfterTheOverflowKeepTheirOrder) {
+    press_key(0, 0);
+    run_one_scan_loop();
+    press_key(1, 0);
+    run_one_scan_loop();
+    press_key(2, 0);
+    run_one_scan_loop();
+    release_key(1, 0);
+    run_one_scan_loop();
+    // buffer full, B is still held
+    release_key(2, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(reports(), (std::vector<Report>{
+        Report(MOD_BIT(KC_LSFT), {}),
+        Report(MOD_BIT(KC_LSFT), {KC_B}), Report(MOD_BIT(KC_LSFT), {KC_B, KC_C}),
+        Report(MOD_BIT(KC_LSFT), {KC_C}), Report(MOD_BIT(KC_LSFT), {}),
+        Report(0, {})
+    }));
+    EXPECT_EQ(action_tapping_buffer_overflows(), 1);
+}
+
+TEST_F(TappingBuffer, StatsCanBeCleared) {
+    press_key(0, 0);
+    run_one_scan_loop();
+    tap(1);
+    tap(2);
+    EXPECT_EQ(action_tapping_buffer_overflows(), 1);
+    action_tapping_clear_buffer_stats();
+    EXPECT_EQ(action_tapping_buffer_peak(), 0);
+    EXPECT_EQ(action_tapping_buffer_overflows(), 0);
+    release_key(0, 0);
+    run_one_scan_loop();
+}
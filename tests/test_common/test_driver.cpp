@@ -17,6 +17,7 @@
 #include "test_driver.h"
 
 TestDriver* TestDriver::m_this = nullptr;
+uint32_t TestDriver::m_reports_sent = 0;
 
 TestDriver::TestDriver()
     : m_driver{
@@ -40,18 +41,21 @@ uint8_t TestDriver::keyboard_leds(void) {
 }
 
 void TestDriver::send_keyboard(report_keyboard_t* report) {
+    m_reports_sent++;
     m_this->send_keyboard_mock(*report);
-
 }
 
 void TestDriver::send_mouse(report_mouse_t* report) {
+    m_reports_sent++;
     m_this->send_mouse_mock(*report);
 }
 
 void TestDriver::send_system(uint16_t data) {
+    m_reports_sent++;
     m_this->send_system_mock(data);
 }
 
 void TestDriver::send_consumer(uint16_t data) {
-    m_this->send_consumer(data);
+    m_reports_sent++;
+    m_this->send_consumer_mock(data);
 }
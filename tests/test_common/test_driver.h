@@ -28,6 +28,8 @@ public:
     TestDriver();
     ~TestDriver();
     void set_leds(uint8_t leds) { m_leds = leds; }
+    // Number of reports of any kind sent to the host so far
+    static uint32_t reports_sent() { return m_reports_sent; }
     
     MOCK_METHOD1(send_keyboard_mock, void (report_keyboard_t&));
     MOCK_METHOD1(send_mouse_mock, void (report_mouse_t&));
@@ -42,6 +44,7 @@ private:
     host_driver_t m_driver;
     uint8_t m_leds = 0;
     static TestDriver* m_this;
+    static uint32_t m_reports_sent;
 };
 
 
@@ -3,11 +3,15 @@
 #include "test_driver.h"
 #include "test_matrix.h"
 #include "keyboard.h"
+#include "action.h"
+#include "action_tapping.h"
+#include "timer.h"
 
 using testing::_;
 using testing::AnyNumber;
 using testing::Return;
 using testing::Between;
+using testing::Invoke;
 
 void TestFixture::SetUpTestCase() {
     TestDriver driver;
@@ -25,12 +29,85 @@ TestFixture::~TestFixture() {
     TestDriver driver;
     clear_all_keys();
     // Run for a while to make sure all keys are completely released
-    // Should probably wait until tapping term etc, has timed out
     EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
-    for (int i=0; i<100; i++) {
-        keyboard_task();
-    }
+    idle_for(TAPPING_TERM * 2);
     testing::Mock::VerifyAndClearExpectations(&driver); 
     // Verify that the matrix really is cleared
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(Between(0, 1));
-}
\ No newline at end of file
+}
+
+void TestFixture::run_one_scan_loop() {
+    keyboard_task();
+    advance_time(1);
+}
+
+void TestFixture::idle_for(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        run_one_scan_loop();
+    }
+}
+
+uint32_t TestFixture::run_until_idle(uint32_t quiet_ms, uint32_t limit_ms) {
+    uint32_t quiet = 0;
+    uint32_t elapsed = 0;
+    while (quiet < quiet_ms && elapsed < limit_ms) {
+        uint32_t reports = TestDriver::reports_sent();
+        run_one_scan_loop();
+        elapsed++;
+        quiet = TestDriver::reports_sent() == reports ? quiet + 1 : 0;
+    }
+    return elapsed;
+}
+
+uint32_t TestFixture::run_until_next_report(uint32_t limit_ms) {
+    uint32_t reports = TestDriver::reports_sent();
+    for (uint32_t elapsed = 0; elapsed < limit_ms; elapsed++) {
+        keyboard_task();
+        if (TestDriver::reports_sent() != reports) {
+            return elapsed;
+        }
+        advance_time(1);
+    }
+    return limit_ms;
+}
+
+std::vector<uint8_t> report_keys(const report_keyboard_t& report) {
+    std::vector<uint8_t> keys;
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report.keys[i]) {
+            keys.push_back(report.keys[i]);
+        }
+    }
+    return keys;
+}
+
+ReportRecorder::ReportRecorder(TestDriver& driver) {
+    ON_CALL(driver, send_keyboard_mock(_)).WillByDefault(Invoke([this](report_keyboard_t& report) {
+        reports.push_back(SentReport{report.mods, report_keys(report), timer_read32()});
+    }));
+}
+
+std::vector<SentReport> ReportRecorder::key_changes() const {
+    std::vector<SentReport> changes;
+    std::vector<uint8_t> last_keys;
+    for (auto& report : reports) {
+        if (report.keys != last_keys) {
+            changes.push_back(report);
+        }
+        last_keys = report.keys;
+    }
+    return changes;
+}
+
+std::vector<SentReport> ReportRecorder::taps() const {
+    std::vector<SentReport> taps;
+    uint8_t last_key = 0;
+    for (auto& report : reports) {
+        uint8_t key = report.keys.empty() ? 0 : report.keys[0];
+        if (key && key != last_key) {
+            taps.push_back(report);
+        }
+        last_key = key;
+    }
+    return taps;
+}
@@ -17,6 +17,15 @@
  #pragma once
 
 #include "gtest/gtest.h"
+#include <stdint.h>
+#include <vector>
+#include "test_driver.h"
+
+// The virtual clock of the TEST platform timer
+extern "C" {
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
 
 class TestFixture : public testing::Test {
 public:
@@ -25,4 +34,40 @@ public:
     static void SetUpTestCase();
     static void TearDownTestCase();
 
-};
\ No newline at end of file
+    // Runs keyboard_task() once and then lets 1 ms pass
+    void run_one_scan_loop();
+    // Keeps scanning every millisecond for the given time
+    void idle_for(uint32_t ms);
+    // Scans until no report has been sent for quiet_ms, and returns the time
+    // it took. Gives up after limit_ms.
+    uint32_t run_until_idle(uint32_t quiet_ms = 1000, uint32_t limit_ms = 60000);
+    // Scans until a timeout makes the keyboard send its next report, and
+    // returns the time that took. Gives up after limit_ms.
+    uint32_t run_until_next_report(uint32_t limit_ms = 60000);
+};
+
+// A keyboard report as the host got it
+struct SentReport {
+    uint8_t mods;
+    std::vector<uint8_t> keys;
+    // When it was sent, on the virtual clock
+    uint32_t time;
+};
+
+// The keys held in a report, in the order they are in it
+std::vector<uint8_t> report_keys(const report_keyboard_t& report);
+
+// Records every keyboard report sent through the driver. It is the default
+// action of the mock, so expectations can still be set on top of it.
+class ReportRecorder {
+public:
+    ReportRecorder(TestDriver& driver);
+    void clear() { reports.clear(); }
+    // The reports whose keys differ from those of the report before
+    std::vector<SentReport> key_changes() const;
+    // The reports that start a tap: their first key is not that of the
+    // report before
+    std::vector<SentReport> taps() const;
+
+    std::vector<SentReport> reports;
+};
@@ -0,0 +1,130 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+using testing::AnyNumber;
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{MT(MOD_LSFT, KC_A), KC_B, OSM(MOD_LCTL)}},
+};
+
+class TicklessIdle : public TestFixture {
+public:
+    // the mods of the last report sent
+    uint8_t last_mods() {
+        return recorder.reports.empty() ? 0 : recorder.reports.back().mods;
+    }
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(TicklessIdle, IdleScansSleepWithoutATick) {
+    keyboard_clear_scan_counts();
+    uint32_t start = timer_read32();
+    for (int i = 0; i < 5; i++) {
+        keyboard_task();
+    }
+    EXPECT_EQ(keyboard_scan_count(), 5);
+    EXPECT_EQ(keyboard_idle_count(), 5);
+    EXPECT_EQ(timer_read32() - start, 5 * TICKLESS_IDLE_SLEEP);
+}
+
+TEST_F(TicklessIdle, KeyChangesAreNotIdle) {
+    keyboard_clear_scan_counts();
+    press_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    keyboard_task();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    keyboard_task();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_EQ(keyboard_scan_count(), 2);
+    EXPECT_EQ(keyboard_idle_count(), 0);
+}
+
+TEST_F(TicklessIdle, SleepEndsAtTheTappingTerm) {
+    press_key(0, 0);
+    keyboard_task();
+    uint32_t start = timer_read32();
+    keyboard_clear_scan_counts();
+    EXPECT_CALL(driver, send_keyboard_mock(_));
+    run_until_next_report();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_EQ(last_mods(), MOD_BIT(KC_LSFT));
+    // the hold is registered on time, by a far smaller number of scans
+    EXPECT_GE(timer_read32() - start, TAPPING_TERM - 1);
+    EXPECT_LE(timer_read32() - start, TAPPING_TERM + 1);
+    EXPECT_LT(keyboard_scan_count(), TAPPING_TERM / 2);
+    EXPECT_EQ(keyboard_scan_count() - keyboard_idle_count(), 1);
+
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(TicklessIdle, TapIsStillATap) {
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    // each idle scan also sleeps, so count the time instead of the scans
+    uint32_t start = timer_read32();
+    while (timer_read32() - start < TAPPING_TERM / 2) {
+        run_one_scan_loop();
+    }
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(0, 0);
+    testing::InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(TicklessIdle, OneShotTimeoutGetsATick) {
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    press_key(2, 0);
+    run_one_scan_loop();
+    release_key(2, 0);
+    run_one_scan_loop();
+    uint32_t start = timer_read32();
+    keyboard_clear_scan_counts();
+    while (timer_read32() - start <= ONESHOT_TIMEOUT) {
+        keyboard_task();
+    }
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_EQ(keyboard_scan_count() - keyboard_idle_count(), 1);
+    EXPECT_EQ(get_oneshot_mods(), 0);
+
+    press_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
@@ -0,0 +1,100 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <string>
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_P, KC_O, KC_Q, KC_X, KC_1}, {KC_BSPC, KC_ENT, KC_ESC, KC_NO, KC_NO}},
+};
+
+extern "C" {
+const qk_ucis_symbol_t ucis_symbol_table[] = UCIS_TABLE(
+    UCIS_SYM("poo", 0x1f4a8),
+    UCIS_SYM("poop", 0x1f4a9),
+    UCIS_SYM("x1", 0x00b9)
+);
+}
+
+class UcisEarlyCommit : public TestFixture {
+public:
+    UcisEarlyCommit() {
+        qk_ucis_start();
+        idle_for(UNICODE_TYPE_DELAY * 2);
+        recorder.clear();
+    }
+
+    static char key_char(uint8_t key) {
+        if (KC_A <= key && key <= KC_Z) return 'a' + key - KC_A;
+        if (KC_1 <= key && key <= KC_9) return '1' + key - KC_1;
+        if (key == KC_0) return '0';
+        if (key == KC_BSPC) return '<';
+        return '?';
+    }
+
+    void tap(uint8_t col, uint8_t row) {
+        press_key(col, row);
+        run_one_scan_loop();
+        release_key(col, row);
+        run_one_scan_loop();
+        // Let queued unicode input go out
+        idle_for(UNICODE_TYPE_DELAY * 2);
+    }
+
+    // the tapped keys
+    std::string typed() {
+        std::string text;
+        for (auto& report : recorder.taps()) {
+            text += key_char(report.keys[0]);
+        }
+        return text;
+    }
+
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(UcisEarlyCommit, UniquePrefixIsCommittedAtOnce) {
+    tap(3, 0);
+    EXPECT_FALSE(process_ucis_sees_all_keys());
+    // The last key is not sent, only the start symbol is erased for it
+    EXPECT_EQ(typed(), "<00b9");
+}
+
+TEST_F(UcisEarlyCommit, WaitsWhileALongerSymbolCouldFollow) {
+    tap(0, 0);
+    tap(1, 0);
+    tap(1, 0);
+    EXPECT_TRUE(process_ucis_sees_all_keys());
+    tap(0, 0);
+    EXPECT_FALSE(process_ucis_sees_all_keys());
+    EXPECT_EQ(typed(), "poo<<<<1f4a9");
+}
+
+TEST_F(UcisEarlyCommit, EnterSendsTheShorterSymbol) {
+    tap(0, 0);
+    tap(1, 0);
+    tap(1, 0);
+    tap(1, 1);
+    EXPECT_EQ(typed(), "poo<<<<1f4a8");
+}
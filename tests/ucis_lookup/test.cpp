@@ -0,0 +1,195 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <string>
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{KC_P, KC_O, KC_Q, KC_X, KC_1}, {KC_BSPC, KC_ENT, KC_ESC, KC_NO, KC_NO}},
+};
+
+// 2704 generated symbols, "aaa" to "dzz", followed by the real ones
+#define SYM(s) UCIS_SYM(s, 0x2603)
+#define ROW(p) SYM(p "a"), SYM(p "b"), SYM(p "c"), SYM(p "d"), SYM(p "e"), SYM(p "f"), SYM(p "g"), \
+    SYM(p "h"), SYM(p "i"), SYM(p "j"), SYM(p "k"), SYM(p "l"), SYM(p "m"), SYM(p "n"), SYM(p "o"), \
+    SYM(p "p"), SYM(p "q"), SYM(p "r"), SYM(p "s"), SYM(p "t"), SYM(p "u"), SYM(p "v"), SYM(p "w"), \
+    SYM(p "x"), SYM(p "y"), SYM(p "z")
+#define BLOCK(p) ROW(p "a"), ROW(p "b"), ROW(p "c"), ROW(p "d"), ROW(p "e"), ROW(p "f"), ROW(p "g"), \
+    ROW(p "h"), ROW(p "i"), ROW(p "j"), ROW(p "k"), ROW(p "l"), ROW(p "m"), ROW(p "n"), ROW(p "o"), \
+    ROW(p "p"), ROW(p "q"), ROW(p "r"), ROW(p "s"), ROW(p "t"), ROW(p "u"), ROW(p "v"), ROW(p "w"), \
+    ROW(p "x"), ROW(p "y"), ROW(p "z")
+
+extern "C" {
+const qk_ucis_symbol_t ucis_symbol_table[] = UCIS_TABLE(
+    BLOCK("a"), BLOCK("b"), BLOCK("c"), BLOCK("d"),
+    UCIS_SYM("poo", 0x1f4a8),
+    UCIS_SYM("poop", 0x1f4a9),
+    UCIS_SYM("x1", 0x00b9)
+);
+}
+
+static const uint16_t table_size = sizeof(ucis_symbol_table) / sizeof(ucis_symbol_table[0]) - 1;
+
+class UcisLookup : public TestFixture {
+public:
+    UcisLookup() {
+        qk_ucis_start();
+        idle_for(UNICODE_TYPE_DELAY * 2);
+        recorder.clear();
+    }
+
+    static char key_char(uint8_t key) {
+        if (KC_A <= key && key <= KC_Z) return 'a' + key - KC_A;
+        if (KC_1 <= key && key <= KC_9) return '1' + key - KC_1;
+        if (key == KC_0) return '0';
+        if (key == KC_BSPC) return '<';
+        return '?';
+    }
+
+    void tap(uint8_t col, uint8_t row) {
+        press_key(col, row);
+        run_one_scan_loop();
+        release_key(col, row);
+        run_one_scan_loop();
+        // Let queued unicode input go out
+        idle_for(UNICODE_TYPE_DELAY * 2);
+    }
+
+    // the tapped keys
+    std::string typed() {
+        std::string text;
+        for (auto& report : recorder.taps()) {
+            text += key_char(report.keys[0]);
+        }
+        return text;
+    }
+
+    // for each tapped key, 'a' with only Alt, '-' without mods
+    std::string mods() {
+        std::string text;
+        for (auto& report : recorder.taps()) {
+            text += report.mods == MOD_BIT(KC_LALT) ? 'a' : report.mods ? '?' : '-';
+        }
+        return text;
+    }
+
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(UcisLookup, FindsTheSymbol) {
+    tap(0, 0);
+    tap(1, 0);
+    tap(1, 0);
+    tap(0, 0);
+    tap(1, 1);
+    EXPECT_FALSE(process_ucis_sees_all_keys());
+    // The typed keys and the start symbol are erased
+    EXPECT_EQ(typed(), "poop<<<<<1f4a9");
+}
+
+TEST_F(UcisLookup, FindsASymbolThatStartsALongerOne) {
+    tap(0, 0);
+    tap(1, 0);
+    tap(1, 0);
+    tap(1, 1);
+    EXPECT_EQ(typed(), "poo<<<<1f4a8");
+}
+
+TEST_F(UcisLookup, FindsASymbolWithDigits) {
+    tap(3, 0);
+    tap(4, 0);
+    tap(1, 1);
+    EXPECT_EQ(typed(), "x1<<<00b9");
+}
+
+TEST_F(UcisLookup, FollowsBackspace) {
+    tap(0, 0);
+    tap(1, 0);
+    tap(3, 0);
+    tap(0, 1);
+    tap(1, 0);
+    tap(0, 0);
+    tap(1, 1);
+    EXPECT_EQ(typed(), "pox<op<<<<<1f4a9");
+}
+
+TEST_F(UcisLookup, RetypesAnUnknownSymbol) {
+    tap(2, 0);
+    tap(2, 0);
+    tap(1, 1);
+    EXPECT_EQ(typed(), "qq<<<qq");
+}
+
+TEST_F(UcisLookup, EscapeErasesTheInput) {
+    tap(2, 0);
+    tap(2, 1);
+    EXPECT_FALSE(process_ucis_sees_all_keys());
+    EXPECT_EQ(typed(), "q<<");
+    EXPECT_TRUE(recorder.reports.back().keys.empty());
+}
+
+TEST_F(UcisLookup, HexDigitsAreTypedWithAltOnOsx) {
+    set_unicode_input_mode(UC_OSX);
+    tap(3, 0);
+    tap(4, 0);
+    tap(1, 1);
+    EXPECT_EQ(typed(), "x1<<<00b9");
+    EXPECT_EQ(mods(), "-----aaaa");
+
+    // unknown names are typed back without Alt
+    qk_ucis_start();
+    idle_for(UNICODE_TYPE_DELAY * 2);
+    recorder.clear();
+    tap(2, 0);
+    tap(1, 1);
+    EXPECT_EQ(typed(), "q<<q");
+    EXPECT_EQ(mods(), "----");
+}
+
+TEST_F(UcisLookup, LookupCost) {
+    tap(0, 0);
+    tap(1, 0);
+    tap(1, 0);
+    tap(0, 0);
+    uint32_t enter = timer_read32();
+    tap(1, 1);
+    ASSERT_EQ(typed(), "poop<<<<<1f4a9");
+
+    // Two binary searches of the remaining range per typed key, where
+    // checking every symbol would take table_size comparisons
+    uint16_t compared = get_ucis_symbols_compared();
+    RecordProperty("table_size", table_size);
+    RecordProperty("symbols_compared", compared);
+    EXPECT_LE(compared, 4 * 2 * 12);
+    EXPECT_LT(compared * 20, table_size);
+
+    // The erasing keys and the digits are queued, only the start of the
+    // input waits UNICODE_TYPE_DELAY
+    uint16_t taps = recorder.taps().size();
+    uint32_t latency = recorder.reports.back().time - enter;
+    RecordProperty("keys_sent", taps);
+    RecordProperty("latency_ms", latency);
+    EXPECT_EQ(taps, 14);
+    EXPECT_LE(latency, UNICODE_TYPE_DELAY + 2);
+}
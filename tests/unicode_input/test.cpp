@@ -0,0 +1,140 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{UC(0x2603), UC(0x00e9), KC_LSFT, KC_A}},
+};
+
+struct Sent {
+    uint8_t mods;
+    uint8_t key;
+    bool operator==(const Sent& other) const {
+        return mods == other.mods && key == other.key;
+    }
+};
+
+std::ostream& operator<<(std::ostream& stream, const Sent& sent) {
+    return stream << "{" << (int)sent.mods << ", " << (int)sent.key << "}";
+}
+
+#define CS (MOD_BIT(KC_LCTL) | MOD_BIT(KC_LSFT))
+#define SHIFT MOD_BIT(KC_LSFT)
+#define ALT MOD_BIT(KC_LALT)
+
+class UnicodeInput : public TestFixture {
+public:
+    UnicodeInput() {
+        set_unicode_input_mode(UC_LNX);
+    }
+
+    void type(uint8_t col) {
+        press_key(col, 0);
+        run_one_scan_loop();
+        release_key(col, 0);
+        run_until_idle(100);
+    }
+
+    // the mods and the first key of each report
+    std::vector<Sent> sent() {
+        std::vector<Sent> sent;
+        for (auto& report : recorder.reports) {
+            sent.push_back({report.mods, report.keys.empty() ? (uint8_t)0 : report.keys[0]});
+        }
+        return sent;
+    }
+
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(UnicodeInput, LinuxSendsOneReportPerStep) {
+    type(0);
+    std::vector<Sent> expected = {
+        {CS, KC_U}, {0, 0}, {0, KC_2}, {0, KC_6}, {0, KC_0}, {0, KC_3}, {0, KC_SPC}, {0, 0},
+    };
+    EXPECT_EQ(sent(), expected);
+}
+
+TEST_F(UnicodeInput, HeldModsAreLeftOutAndRestoredInOneReport) {
+    press_key(2, 0);
+    run_one_scan_loop();
+    recorder.clear();
+    type(0);
+    std::vector<Sent> expected = {
+        {CS, KC_U}, {0, 0}, {0, KC_2}, {0, KC_6}, {0, KC_0}, {0, KC_3}, {0, KC_SPC}, {0, 0}, {SHIFT, 0},
+    };
+    EXPECT_EQ(sent(), expected);
+    release_key(2, 0);
+    run_one_scan_loop();
+}
+
+TEST_F(UnicodeInput, RepeatedDigitIsReleasedInBetween) {
+    type(1);
+    std::vector<Sent> expected = {
+        {CS, KC_U}, {0, 0}, {0, KC_0}, {0, 0}, {0, KC_0}, {0, KC_E}, {0, KC_9}, {0, KC_SPC}, {0, 0},
+    };
+    EXPECT_EQ(sent(), expected);
+}
+
+TEST_F(UnicodeInput, ReportsAreSpacedByTheDelayOfTheInputMode) {
+    type(0);
+    auto& sent = recorder.reports;
+    ASSERT_EQ(sent.size(), 8);
+    // The input method gets UNICODE_TYPE_DELAY after the start sequence
+    EXPECT_GE(sent[1].time - sent[0].time, UNICODE_REPORT_DELAY_LNX);
+    EXPECT_GE(sent[2].time - sent[1].time, UNICODE_TYPE_DELAY);
+    for (size_t i = 3; i < sent.size(); i++) {
+        EXPECT_GE(sent[i].time - sent[i - 1].time, UNICODE_REPORT_DELAY_LNX);
+    }
+    uint32_t total = sent.back().time - sent.front().time;
+    RecordProperty("reports", sent.size());
+    RecordProperty("time_ms", total);
+    EXPECT_LE(total, UNICODE_TYPE_DELAY + 6 * UNICODE_REPORT_DELAY_LNX + 2);
+}
+
+TEST_F(UnicodeInput, KeysPressedMeanwhileWaitTheirTurn) {
+    press_key(0, 0);
+    run_one_scan_loop();
+    press_key(3, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    release_key(3, 0);
+    run_until_idle(100);
+    std::vector<Sent> expected = {
+        {CS, KC_U}, {0, 0}, {0, KC_2}, {0, KC_6}, {0, KC_0}, {0, KC_3}, {0, KC_SPC}, {0, 0},
+        {0, KC_A}, {0, 0},
+    };
+    EXPECT_EQ(sent(), expected);
+}
+
+TEST_F(UnicodeInput, MacHoldsAltWhileTypingTheDigits) {
+    set_unicode_input_mode(UC_OSX);
+    type(0);
+    std::vector<Sent> expected = {
+        {ALT, 0}, {ALT, KC_2}, {ALT, KC_6}, {ALT, KC_0}, {ALT, KC_3}, {0, 0},
+    };
+    EXPECT_EQ(sent(), expected);
+}
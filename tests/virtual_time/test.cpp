@@ -0,0 +1,96 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "quantum.h"
+}
+#include "test_driver.h"
+#include "test_matrix.h"
+#include "keyboard_report_util.h"
+#include "test_fixture.h"
+
+using testing::_;
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    {{MT(MOD_LSFT, KC_A), KC_B}, {KC_C, KC_D}},
+};
+
+class VirtualTime : public TestFixture {
+public:
+    // the mods of the last report sent
+    uint8_t last_mods() {
+        return recorder.reports.empty() ? 0 : recorder.reports.back().mods;
+    }
+    testing::NiceMock<TestDriver> driver;
+    ReportRecorder recorder{driver};
+};
+
+TEST_F(VirtualTime, TimerFollowsTheVirtualClock) {
+    set_time(1000);
+    uint16_t start = timer_read();
+    EXPECT_EQ(timer_elapsed(start), 0);
+    advance_time(250);
+    EXPECT_EQ(timer_elapsed(start), 250);
+    EXPECT_EQ(timer_read32(), 1250);
+
+    set_time(0xFFF0);
+    start = timer_read();
+    advance_time(0x20);
+    EXPECT_EQ(timer_read(), 0x10);
+    EXPECT_GE(timer_elapsed(start), 0x1F);
+    EXPECT_EQ(timer_elapsed32(0xFFF0), 0x20);
+}
+
+TEST_F(VirtualTime, ModTapIsAModifierAfterTheTappingTerm) {
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_));
+    uint32_t waited = run_until_next_report();
+    EXPECT_GT(waited, TAPPING_TERM - 2);
+    EXPECT_LE(waited, TAPPING_TERM + 2);
+    EXPECT_EQ(last_mods(), MOD_BIT(KC_LSFT));
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    EXPECT_EQ(last_mods(), 0);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+}
+
+TEST_F(VirtualTime, ModTapIsAKeyWhenTappedWithinTheTerm) {
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(TAPPING_TERM / 2);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(0, 0);
+    testing::InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_EQ(last_mods(), 0);
+}
+
+TEST_F(VirtualTime, RunUntilIdleStopsOnceNothingHappens) {
+    press_key(1, 0);
+    run_one_scan_loop();
+    release_key(1, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(run_until_idle(100), 100);
+    EXPECT_EQ(run_until_next_report(500), 500);
+}
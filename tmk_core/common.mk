@@ -47,6 +47,11 @@ else
     TMK_COMMON_SRC += $(COMMON_DIR)/magic.c
 endif
 
+ifeq ($(strip $(DEFERRED_EXEC_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/deferred_exec.c
+    TMK_COMMON_DEFS += -DDEFERRED_EXEC_ENABLE
+endif
+
 ifeq ($(strip $(MOUSEKEY_ENABLE)), yes)
     TMK_COMMON_SRC += $(COMMON_DIR)/mousekey.c
     TMK_COMMON_DEFS += -DMOUSEKEY_ENABLE
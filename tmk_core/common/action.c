@@ -17,6 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "host.h"
 #include "keycode.h"
 #include "keyboard.h"
+#include "keymap.h"
 #include "mousekey.h"
 #include "command.h"
 #include "led.h"
@@ -84,6 +85,27 @@ void action_exec(keyevent_t event)
 #endif
 }
 
+/* Milliseconds until action_exec(TICK) has something to do, 0 when a
+ * timeout is due now and UINT16_MAX when nothing is waiting.
+ */
+uint16_t action_tick_next(void)
+{
+#ifdef FAUXCLICKY_ENABLE
+    // the click is stopped from the tick
+    return 0;
+#else
+    uint16_t next = UINT16_MAX;
+#ifndef NO_ACTION_ONESHOT
+    next = oneshot_next();
+#endif
+#ifndef NO_ACTION_TAPPING
+    uint16_t tapping_next = action_tapping_next();
+    if (tapping_next < next) next = tapping_next;
+#endif
+    return next;
+#endif
+}
+
 #ifdef ONEHAND_ENABLE
 bool swap_hands = false;
 
@@ -129,10 +151,16 @@ void process_record(keyrecord_t *record)
 {
     if (IS_NOEVENT(record->event)) { return; }
 
+    /* Resolve the key once. process_record_quantum() and the action both
+     * use the keycode, so the layers are only walked once per event.
+     */
+    uint8_t layer = store_or_get_layer(record->event.pressed, record->event.key);
+    record->keycode = keymap_key_to_keycode(layer, record->event.key);
+
     if(!process_record_quantum(record))
         return;
 
-    action_t action = store_or_get_action(record->event.pressed, record->event.key);
+    action_t action = action_for_keycode(record->keycode);
     dprint("ACTION: "); debug_action(action);
 #ifndef NO_ACTION_LAYER
     dprint(" layer_state: "); layer_debug();
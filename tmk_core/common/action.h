@@ -44,14 +44,21 @@ typedef struct {
 #ifndef NO_ACTION_TAPPING
     tap_t tap;
 #endif
+    /* keycode of the key, resolved once per event by process_record() */
+    uint16_t keycode;
 } keyrecord_t;
 
 /* Execute action per keyevent */
 void action_exec(keyevent_t event);
+/* Time until a TICK event is needed (ms) */
+uint16_t action_tick_next(void);
 
 /* action for key */
 action_t action_for_key(uint8_t layer, keypos_t key);
 
+/* action for an already resolved keycode */
+action_t action_for_keycode(uint16_t keycode);
+
 /* macro */
 const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt);
 
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <string.h>
 #include "keyboard.h"
 #include "action.h"
 #include "util.h"
@@ -163,11 +164,11 @@ uint8_t read_source_layers_cache(keypos_t key)
  * when the layer is switched after the down event but before the up
  * event as they may get stuck otherwise.
  */
-action_t store_or_get_action(bool pressed, keypos_t key)
+uint8_t store_or_get_layer(bool pressed, keypos_t key)
 {
 #if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
     if (disable_action_cache) {
-        return layer_switch_get_action(key);
+        return layer_switch_get_layer(key);
     }
 
     uint8_t layer;
@@ -179,19 +180,77 @@ action_t store_or_get_action(bool pressed, keypos_t key)
     else {
         layer = read_source_layers_cache(key);
     }
-    return action_for_key(layer, key);
+    return layer;
 #else
-    return layer_switch_get_action(key);
+    return layer_switch_get_layer(key);
 #endif
 }
 
+action_t store_or_get_action(bool pressed, keypos_t key)
+{
+    return action_for_key(store_or_get_layer(pressed, key), key);
+}
+
+
+#ifndef NO_ACTION_LAYER
+/*
+ * Resolved layer cache
+ *
+ * Remembers the topmost non-transparent layer of the keys for the current
+ * layer state, so the layers don't have to be walked again for the same key.
+ * With LAYER_LOOKUP_CACHE every key is remembered, otherwise only the last
+ * one, which is enough for the tapping code and process_record() that look
+ * up the same key right after each other. The cache is emptied lazily on
+ * the first lookup after the layer state has changed.
+ */
+#ifdef LAYER_LOOKUP_CACHE
+static int8_t layer_cache[MATRIX_ROWS][MATRIX_COLS];
+#else
+static keypos_t layer_cache_key;
+static int8_t layer_cache_layer;
+#endif
+static uint32_t layer_cache_state;
+static bool layer_cache_valid = false;
+
+void layer_cache_clear(void)
+{
+    layer_cache_valid = false;
+}
+
+static int8_t layer_switch_walk_layers(keypos_t key);
 
 int8_t layer_switch_get_layer(keypos_t key)
+{
+    uint32_t layers = layer_state | default_layer_state;
+    if (!layer_cache_valid || layers != layer_cache_state) {
+#ifdef LAYER_LOOKUP_CACHE
+        memset(layer_cache, -1, sizeof(layer_cache));
+#else
+        layer_cache_layer = -1;
+#endif
+        layer_cache_state = layers;
+        layer_cache_valid = true;
+    }
+#ifdef LAYER_LOOKUP_CACHE
+    int8_t *layer = &layer_cache[key.row][key.col];
+#else
+    if (!KEYEQ(layer_cache_key, key)) {
+        layer_cache_key = key;
+        layer_cache_layer = -1;
+    }
+    int8_t *layer = &layer_cache_layer;
+#endif
+    if (*layer < 0) {
+        *layer = layer_switch_walk_layers(key);
+    }
+    return *layer;
+}
+
+static int8_t layer_switch_walk_layers(keypos_t key)
 {
     action_t action;
     action.code = ACTION_TRANSPARENT;
 
-#ifndef NO_ACTION_LAYER
     uint32_t layers = layer_state | default_layer_state;
     /* check top layer first */
     for (int8_t i = 31; i >= 0; i--) {
@@ -204,10 +263,13 @@ int8_t layer_switch_get_layer(keypos_t key)
     }
     /* fall back to layer 0 */
     return 0;
+}
 #else
+int8_t layer_switch_get_layer(keypos_t key)
+{
     return biton32(default_layer_state);
-#endif
 }
+#endif
 
 action_t layer_switch_get_action(keypos_t key)
 {
@@ -59,6 +59,8 @@ void layer_invert(uint8_t layer);
 void layer_or(uint32_t state);
 void layer_and(uint32_t state);
 void layer_xor(uint32_t state);
+
+uint32_t layer_state_set_kb(uint32_t state);
 #else
 #define layer_state             0
 #define layer_clear()
@@ -83,11 +85,19 @@ uint32_t layer_state_set_kb(uint32_t state);
 void update_source_layers_cache(keypos_t key, uint8_t layer);
 uint8_t read_source_layers_cache(keypos_t key);
 #endif
+uint8_t store_or_get_layer(bool pressed, keypos_t key);
 action_t store_or_get_action(bool pressed, keypos_t key);
 
 /* return the topmost non-transparent layer currently associated with key */
 int8_t layer_switch_get_layer(keypos_t key);
 
+/* resolved layer cache, clear it when the keymap itself changes */
+#ifndef NO_ACTION_LAYER
+void layer_cache_clear(void);
+#else
+#define layer_cache_clear()
+#endif
+
 /* return action depending on current layer status */
 action_t layer_switch_get_action(keypos_t key);
 
@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action_util.h"
 #include "action_macro.h"
 #include "wait.h"
+#include "timer.h"
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
@@ -28,58 +29,261 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #ifndef NO_ACTION_MACRO
 
-#define MACRO_READ()  (macro = MACRO_GET(macro_p++))
-void action_macro_play(const macro_t *macro_p)
+/* A macro being played: where it is, how long it waits before its next
+ * command, and the loops and calls it is in.
+ */
+typedef struct {
+    const macro_t *ret;
+    uint8_t count;  // loop: repetitions left, call: 0
+} macro_frame_t;
+
+typedef struct {
+    const macro_t *pc;
+    uint16_t wait_start;
+    uint16_t wait;
+    uint8_t interval;
+    uint8_t depth;
+    macro_frame_t stack[ACTION_MACRO_STACK_DEPTH];
+} macro_state_t;
+
+static macro_state_t macros[ACTION_MACRO_MAX_RUNNING];
+
+__attribute__ ((weak))
+const macro_t *action_get_submacro(uint8_t id)
+{
+    return MACRO_NONE;
+}
+
+/* Bytes taken by a command, for skipping it. */
+static uint8_t macro_command_size(macro_t command)
+{
+    switch (command) {
+        case KEY_DOWN:
+        case KEY_UP:
+        case WAIT:
+        case INTERVAL:
+        case LOOP:
+        case CALL:
+        case IF_MODS:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+/* Move past the close command matching an open one just run. */
+static void macro_skip(macro_state_t *m, macro_t open, macro_t close)
+{
+    uint8_t nesting = 1;
+    while (nesting) {
+        macro_t command = MACRO_GET(m->pc);
+        if (command == END) break;
+        if (command == open) nesting++;
+        if (command == close) nesting--;
+        m->pc += macro_command_size(command);
+    }
+}
+
+/* Return from the innermost call, false at the end of the macro. */
+static bool macro_return(macro_state_t *m)
+{
+    while (m->depth) {
+        macro_frame_t *frame = &m->stack[--m->depth];
+        if (frame->count == 0) {
+            m->pc = frame->ret;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool macro_push(macro_state_t *m, const macro_t *ret, uint8_t count)
+{
+    if (m->depth == ACTION_MACRO_STACK_DEPTH) {
+        dprintln("MACRO: stack overflow");
+        return false;
+    }
+    m->stack[m->depth].ret = ret;
+    m->stack[m->depth].count = count;
+    m->depth++;
+    return true;
+}
+
+/* Run one command of the macro, false once it has ended. */
+#define MACRO_READ()  (macro = MACRO_GET(m->pc++))
+static bool macro_step(macro_state_t *m)
 {
     macro_t macro = END;
-    uint8_t interval = 0;
 
-    if (!macro_p) return;
-    while (true) {
-        switch (MACRO_READ()) {
-            case KEY_DOWN:
-                MACRO_READ();
-                dprintf("KEY_DOWN(%02X)\n", macro);
-                if (IS_MOD(macro)) {
-                    add_macro_mods(MOD_BIT(macro));
-                    send_keyboard_report();
+    switch (MACRO_READ()) {
+        case KEY_DOWN:
+            MACRO_READ();
+            dprintf("KEY_DOWN(%02X)\n", macro);
+            if (IS_MOD(macro)) {
+                add_macro_mods(MOD_BIT(macro));
+                send_keyboard_report();
+            } else {
+                register_code(macro);
+            }
+            break;
+        case KEY_UP:
+            MACRO_READ();
+            dprintf("KEY_UP(%02X)\n", macro);
+            if (IS_MOD(macro)) {
+                del_macro_mods(MOD_BIT(macro));
+                send_keyboard_report();
+            } else {
+                unregister_code(macro);
+            }
+            break;
+        case WAIT:
+            MACRO_READ();
+            dprintf("WAIT(%u)\n", macro);
+            m->wait = macro;
+            break;
+        case INTERVAL:
+            m->interval = MACRO_READ();
+            dprintf("INTERVAL(%u)\n", m->interval);
+            break;
+        case LOOP:
+            MACRO_READ();
+            dprintf("LOOP(%u)\n", macro);
+            if (!macro) {
+                // repeated no times, skip to the matching LOOP_END
+                macro_skip(m, LOOP, LOOP_END);
+            } else if (!macro_push(m, m->pc, macro)) {
+                return false;
+            }
+            break;
+        case LOOP_END:
+            dprintf("LOOP_END\n");
+            if (m->depth && m->stack[m->depth - 1].count) {
+                macro_frame_t *frame = &m->stack[m->depth - 1];
+                if (--frame->count) {
+                    m->pc = frame->ret;
                 } else {
-                    register_code(macro);
+                    m->depth--;
                 }
-                break;
-            case KEY_UP:
-                MACRO_READ();
-                dprintf("KEY_UP(%02X)\n", macro);
-                if (IS_MOD(macro)) {
-                    del_macro_mods(MOD_BIT(macro));
-                    send_keyboard_report();
-                } else {
-                    unregister_code(macro);
+            }
+            break;
+        case CALL:
+            MACRO_READ();
+            dprintf("CALL(%u)\n", macro);
+            {
+                const macro_t *sub = action_get_submacro(macro);
+                if (sub) {
+                    if (!macro_push(m, m->pc, 0)) return false;
+                    m->pc = sub;
                 }
-                break;
-            case WAIT:
-                MACRO_READ();
-                dprintf("WAIT(%u)\n", macro);
-                { uint8_t ms = macro; while (ms--) wait_ms(1); }
-                break;
-            case INTERVAL:
-                interval = MACRO_READ();
-                dprintf("INTERVAL(%u)\n", interval);
-                break;
-            case 0x04 ... 0x73:
-                dprintf("DOWN(%02X)\n", macro);
-                register_code(macro);
-                break;
-            case 0x84 ... 0xF3:
-                dprintf("UP(%02X)\n", macro);
-                unregister_code(macro&0x7F);
-                break;
-            case END:
-            default:
-                return;
+            }
+            break;
+        case IF_MODS:
+            MACRO_READ();
+            dprintf("IF_MODS(%02X)\n", macro);
+            if (!(get_mods() & macro)) {
+                // skip to the matching END_IF
+                macro_skip(m, IF_MODS, END_IF);
+            }
+            break;
+        case END_IF:
+            break;
+        case 0x04 ... 0x73:
+            dprintf("DOWN(%02X)\n", macro);
+            register_code(macro);
+            break;
+        case 0x84 ... 0xF3:
+            dprintf("UP(%02X)\n", macro);
+            unregister_code(macro&0x7F);
+            break;
+        case END:
+        default:
+            return macro_return(m);
+    }
+    // interval
+    m->wait += m->interval;
+    return true;
+}
+
+/* Run the macro until it waits, ends or has used up its budget for
+ * this tick. Returns false once it has ended.
+ */
+static bool macro_run(macro_state_t *m)
+{
+    if (m->wait) {
+        if (TIMER_DIFF_16(timer_read(), m->wait_start) < m->wait) return true;
+        m->wait = 0;
+    }
+    for (uint8_t budget = ACTION_MACRO_BUDGET; budget; budget--) {
+        if (!macro_step(m)) {
+            m->pc = MACRO_NONE;
+            return false;
+        }
+        if (m->wait) {
+            m->wait_start = timer_read();
+            return true;
+        }
+    }
+    return true;
+}
+
+void action_macro_play(const macro_t *macro_p)
+{
+    if (!macro_p) return;
+
+    macro_state_t *m = 0;
+    for (uint8_t i = 0; i < ACTION_MACRO_MAX_RUNNING; i++) {
+        if (!macros[i].pc) {
+            m = &macros[i];
+            break;
+        }
+    }
+    if (!m) {
+        // all are busy, play this one right away
+        dprintln("MACRO: no free slot, blocking");
+        macro_state_t blocking = { .pc = macro_p };
+        while (macro_run(&blocking)) {
+            for (; blocking.wait; blocking.wait--) wait_ms(1);
         }
-        // interval
-        { uint8_t ms = interval; while (ms--) wait_ms(1); }
+        return;
+    }
+
+    m->pc = macro_p;
+    m->wait = 0;
+    m->interval = 0;
+    m->depth = 0;
+    // the start of the macro runs as the key is pressed
+    macro_run(m);
+}
+
+void action_macro_task(void)
+{
+    for (uint8_t i = 0; i < ACTION_MACRO_MAX_RUNNING; i++) {
+        if (macros[i].pc) {
+            macro_run(&macros[i]);
+        }
+    }
+}
+
+uint16_t action_macro_next(void)
+{
+    uint16_t next = UINT16_MAX;
+    for (uint8_t i = 0; i < ACTION_MACRO_MAX_RUNNING; i++) {
+        macro_state_t *m = &macros[i];
+        if (!m->pc) continue;
+        if (!m->wait) return 0;
+        uint16_t elapsed = TIMER_DIFF_16(timer_read(), m->wait_start);
+        uint16_t left = elapsed < m->wait ? m->wait - elapsed : 0;
+        if (left < next) next = left;
+    }
+    return next;
+}
+
+uint8_t action_macro_running(void)
+{
+    uint8_t running = 0;
+    for (uint8_t i = 0; i < ACTION_MACRO_MAX_RUNNING; i++) {
+        if (macros[i].pc) running++;
     }
+    return running;
 }
 #endif
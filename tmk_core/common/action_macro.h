@@ -49,10 +49,34 @@ typedef uint8_t macro_t;
      
 
 
+/* Macros that have to wait are played on by action_macro_task(), so
+ * the keyboard keeps running meanwhile. Each of the running macros
+ * runs at most ACTION_MACRO_BUDGET commands a scan.
+ */
+#ifndef ACTION_MACRO_MAX_RUNNING
+#define ACTION_MACRO_MAX_RUNNING 2
+#endif
+#ifndef ACTION_MACRO_BUDGET
+#define ACTION_MACRO_BUDGET 16
+#endif
+/* how deep loops and calls can nest */
+#ifndef ACTION_MACRO_STACK_DEPTH
+#define ACTION_MACRO_STACK_DEPTH 3
+#endif
+
 #ifndef NO_ACTION_MACRO
 void action_macro_play(const macro_t *macro_p);
+void action_macro_task(void);
+/* ms until a running macro has to run again, UINT16_MAX if none is running */
+uint16_t action_macro_next(void);
+uint8_t action_macro_running(void);
+/* the macro run by CALL(id) */
+const macro_t *action_get_submacro(uint8_t id);
 #else
 #define action_macro_play(macro)
+#define action_macro_task()
+#define action_macro_next() UINT16_MAX
+#define action_macro_running() 0
 #endif
 
 
@@ -64,16 +88,15 @@ void action_macro_play(const macro_t *macro_p);
  *   { KEY_UP,   code(0x04-0xff) }      // key up(2bytes)
  *   WAIT                               // wait milli-seconds
  *   INTERVAL                           // set interval between macro commands
- *   END                                // stop macro execution
+ *   { LOOP, count } ... LOOP_END       // repeat the commands count times, skip them if 0
+ *   { CALL, id }                       // run action_get_submacro(id)
+ *   { IF_MODS, mods } ... END_IF       // run the commands if one of mods is held
+ *   END                                // stop macro execution, or return from CALL
  *
  * Ideas(Not implemented):
- *   modifiers
  *   system usage
  *   consumer usage
  *   unicode usage
- *   function call
- *   conditionals
- *   loop
  */
 enum macro_command_id{
     /* 0x00 - 0x03 */
@@ -86,6 +109,11 @@ enum macro_command_id{
     /* 0x74 - 0x83 */
     WAIT                = 0x74,
     INTERVAL,
+    LOOP,
+    LOOP_END,
+    CALL,
+    IF_MODS,
+    END_IF,
 
     /* 0x84 - 0xf3 (reserved for keycode up) */
 
@@ -104,6 +132,9 @@ enum macro_command_id{
 #define TYPE(key)       DOWN(key), UP(key)
 #define WAIT(ms)        WAIT, (ms)
 #define INTERVAL(ms)    INTERVAL, (ms)
+#define LOOP(count)     LOOP, (count)
+#define CALL(id)        CALL, (id)
+#define IF_MODS(mods)   IF_MODS, (mods)
 
 /* key down */
 #define D(key)          DOWN(KC_##key)
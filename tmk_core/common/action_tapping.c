@@ -21,13 +21,29 @@
 #define WITHIN_TAPPING_TERM(e)  (TIMER_DIFF_16(e.time, tapping_key.event.time) < TAPPING_TERM)
 
 
+/* An event held back in the waiting buffer. Its keycode isn't resolved yet,
+ * so only the event and the tap state are kept, packed.
+ */
+typedef struct {
+    keypos_t key;
+    uint16_t time;
+    bool     pressed     :1;
+    bool     interrupted :1;
+    uint8_t  count       :4;
+} waiting_event_t;
+
 static keyrecord_t tapping_key = {};
-static keyrecord_t waiting_buffer[WAITING_BUFFER_SIZE] = {};
+static waiting_event_t waiting_buffer[WAITING_BUFFER_SIZE] = {};
 static uint8_t waiting_buffer_head = 0;
 static uint8_t waiting_buffer_tail = 0;
 
+static uint8_t waiting_buffer_peak = 0;
+static uint16_t waiting_buffer_overflows = 0;
+
 static bool process_tapping(keyrecord_t *record);
 static bool waiting_buffer_enq(keyrecord_t record);
+static void waiting_buffer_process(void);
+static void waiting_buffer_make_room(void);
 static void waiting_buffer_clear(void);
 static bool waiting_buffer_typed(keyevent_t event);
 static bool waiting_buffer_has_anykey_pressed(void);
@@ -44,11 +60,15 @@ void action_tapping_process(keyrecord_t record)
         }
     } else {
         if (!waiting_buffer_enq(record)) {
-            // clear all in case of overflow.
-            debug("OVERFLOW: CLEAR ALL STATES\n");
-            clear_keyboard();
-            waiting_buffer_clear();
-            tapping_key = (keyrecord_t){};
+            waiting_buffer_overflows++;
+            waiting_buffer_make_room();
+            if (!waiting_buffer_enq(record)) {
+                // clear all when that didn't help either.
+                debug("OVERFLOW: CLEAR ALL STATES\n");
+                clear_keyboard();
+                waiting_buffer_clear();
+                tapping_key = (keyrecord_t){};
+            }
         }
     }
 
@@ -56,19 +76,49 @@ void action_tapping_process(keyrecord_t record)
     if (!IS_NOEVENT(record.event) && waiting_buffer_head != waiting_buffer_tail) {
         debug("---- action_exec: process waiting_buffer -----\n");
     }
-    for (; waiting_buffer_tail != waiting_buffer_head; waiting_buffer_tail = (waiting_buffer_tail + 1) % WAITING_BUFFER_SIZE) {
-        if (process_tapping(&waiting_buffer[waiting_buffer_tail])) {
-            debug("processed: waiting_buffer["); debug_dec(waiting_buffer_tail); debug("] = ");
-            debug_record(waiting_buffer[waiting_buffer_tail]); debug("\n\n");
-        } else {
-            break;
-        }
-    }
+    waiting_buffer_process();
     if (!IS_NOEVENT(record.event)) {
         debug("\n");
     }
 }
 
+uint8_t action_tapping_buffer_peak(void)
+{
+    return waiting_buffer_peak;
+}
+
+uint16_t action_tapping_buffer_overflows(void)
+{
+    return waiting_buffer_overflows;
+}
+
+void action_tapping_clear_buffer_stats(void)
+{
+    waiting_buffer_peak = 0;
+    waiting_buffer_overflows = 0;
+}
+
+
+/* Milliseconds until a TICK can settle the tapping key, 0 when it is due
+ * now and UINT16_MAX when nothing waits for the tapping term.
+ */
+uint16_t action_tapping_next(void)
+{
+    if (!IS_TAPPING()) {
+        return waiting_buffer_head != waiting_buffer_tail ? 0 : UINT16_MAX;
+    }
+    // the same time a TICK would carry
+    uint16_t elapsed = TIMER_DIFF_16(timer_read() | 1, tapping_key.event.time);
+    if (elapsed < TAPPING_TERM) {
+        return TAPPING_TERM - elapsed;
+    }
+    // a tap that is still held has nothing left to time out
+    if (IS_TAPPING_PRESSED() && tapping_key.tap.count > 0) {
+        return UINT16_MAX;
+    }
+    return 0;
+}
+
 
 /* Tapping
  *
@@ -291,6 +341,32 @@ bool process_tapping(keyrecord_t *keyp)
 /*
  * Waiting buffer
  */
+static keyrecord_t waiting_buffer_get(uint8_t i)
+{
+    return (keyrecord_t){
+        .event = {
+            .key = waiting_buffer[i].key,
+            .pressed = waiting_buffer[i].pressed,
+            .time = waiting_buffer[i].time
+        },
+        .tap = {
+            .interrupted = waiting_buffer[i].interrupted,
+            .count = waiting_buffer[i].count
+        }
+    };
+}
+
+static void waiting_buffer_put(uint8_t i, keyrecord_t record)
+{
+    waiting_buffer[i] = (waiting_event_t){
+        .key = record.event.key,
+        .time = record.event.time,
+        .pressed = record.event.pressed,
+        .interrupted = record.tap.interrupted,
+        .count = record.tap.count
+    };
+}
+
 bool waiting_buffer_enq(keyrecord_t record)
 {
     if (IS_NOEVENT(record.event)) {
@@ -302,13 +378,46 @@ bool waiting_buffer_enq(keyrecord_t record)
         return false;
     }
 
-    waiting_buffer[waiting_buffer_head] = record;
+    waiting_buffer_put(waiting_buffer_head, record);
     waiting_buffer_head = (waiting_buffer_head + 1) % WAITING_BUFFER_SIZE;
 
+    uint8_t used = (waiting_buffer_head - waiting_buffer_tail + WAITING_BUFFER_SIZE) % WAITING_BUFFER_SIZE;
+    if (used > waiting_buffer_peak) waiting_buffer_peak = used;
+
     debug("waiting_buffer_enq: "); debug_waiting_buffer();
     return true;
 }
 
+/* process the waiting events in order until one has to wait again */
+void waiting_buffer_process(void)
+{
+    for (; waiting_buffer_tail != waiting_buffer_head; waiting_buffer_tail = (waiting_buffer_tail + 1) % WAITING_BUFFER_SIZE) {
+        keyrecord_t record = waiting_buffer_get(waiting_buffer_tail);
+        if (process_tapping(&record)) {
+            debug("processed: waiting_buffer["); debug_dec(waiting_buffer_tail); debug("] = ");
+            debug_record(record); debug("\n\n");
+        } else {
+            // keep the tap state it got
+            waiting_buffer_put(waiting_buffer_tail, record);
+            break;
+        }
+    }
+}
+
+/* The undecided tapping key is what holds the events back, so settle it
+ * the way its tapping term running out would, and let them go.
+ */
+void waiting_buffer_make_room(void)
+{
+    if (IS_TAPPING_PRESSED() && tapping_key.tap.count == 0) {
+        debug("Tapping: End. Buffer full. Not tap(0)\n");
+        process_record(&tapping_key);
+        tapping_key = (keyrecord_t){};
+        debug_tapping_key();
+        waiting_buffer_process();
+    }
+}
+
 void waiting_buffer_clear(void)
 {
     waiting_buffer_head = 0;
@@ -318,7 +427,7 @@ void waiting_buffer_clear(void)
 bool waiting_buffer_typed(keyevent_t event)
 {
     for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (KEYEQ(event.key, waiting_buffer[i].event.key) && event.pressed !=  waiting_buffer[i].event.pressed) {
+        if (KEYEQ(event.key, waiting_buffer[i].key) && event.pressed !=  waiting_buffer[i].pressed) {
             return true;
         }
     }
@@ -329,7 +438,7 @@ __attribute__((unused))
 bool waiting_buffer_has_anykey_pressed(void)
 {
     for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (waiting_buffer[i].event.pressed) return true;
+        if (waiting_buffer[i].pressed) return true;
     }
     return false;
 }
@@ -343,11 +452,11 @@ void waiting_buffer_scan_tap(void)
     if (!tapping_key.event.pressed) return;
 
     for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (IS_TAPPING_KEY(waiting_buffer[i].event.key) &&
-                !waiting_buffer[i].event.pressed &&
-                WITHIN_TAPPING_TERM(waiting_buffer[i].event)) {
+        if (IS_TAPPING_KEY(waiting_buffer[i].key) &&
+                !waiting_buffer[i].pressed &&
+                WITHIN_TAPPING_TERM(waiting_buffer[i])) {
             tapping_key.tap.count = 1;
-            waiting_buffer[i].tap.count = 1;
+            waiting_buffer[i].count = 1;
             process_record(&tapping_key);
 
             debug("waiting_buffer_scan_tap: found at ["); debug_dec(i); debug("]\n");
@@ -370,7 +479,7 @@ static void debug_waiting_buffer(void)
 {
     debug("{ ");
     for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        debug("["); debug_dec(i); debug("]="); debug_record(waiting_buffer[i]); debug(" ");
+        debug("["); debug_dec(i); debug("]="); debug_record(waiting_buffer_get(i)); debug(" ");
     }
     debug("}\n");
 }
@@ -29,11 +29,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define TAPPING_TOGGLE  5
 #endif
 
-#define WAITING_BUFFER_SIZE 8
+/* size of the buffer for events that wait on an undecided tap key */
+#ifndef WAITING_BUFFER_SIZE
+#define WAITING_BUFFER_SIZE 16
+#endif
 
 
 #ifndef NO_ACTION_TAPPING
 void action_tapping_process(keyrecord_t record);
+uint16_t action_tapping_next(void);
+/* most events the waiting buffer has held, and how often it was full */
+uint8_t action_tapping_buffer_peak(void);
+uint16_t action_tapping_buffer_overflows(void);
+void action_tapping_clear_buffer_stats(void);
 #endif
 
 #endif
@@ -116,6 +116,26 @@ bool is_oneshot_layer_active(void)
 {
     return get_oneshot_layer_state();
 }
+
+/* Milliseconds until a oneshot modifier or layer times out, 0 when one is due
+ * now and UINT16_MAX when none is waiting.
+ */
+uint16_t oneshot_next(void)
+{
+    uint16_t next = UINT16_MAX;
+#if (defined(ONESHOT_TIMEOUT) && (ONESHOT_TIMEOUT > 0))
+    if (oneshot_mods) {
+        uint16_t elapsed = TIMER_DIFF_16(timer_read(), oneshot_time);
+        next = elapsed < ONESHOT_TIMEOUT ? ONESHOT_TIMEOUT - elapsed : 0;
+    }
+    if (get_oneshot_layer_state() && !(get_oneshot_layer_state() & ONESHOT_TOGGLED)) {
+        uint16_t elapsed = TIMER_DIFF_16(timer_read(), oneshot_layer_time);
+        uint16_t layer_next = elapsed < ONESHOT_TIMEOUT ? ONESHOT_TIMEOUT - elapsed : 0;
+        if (layer_next < next) next = layer_next;
+    }
+#endif
+    return next;
+}
 #endif
 
 void send_keyboard_report(void) {
@@ -88,6 +88,7 @@ void reset_oneshot_layer(void);
 bool is_oneshot_layer_active(void);
 uint8_t get_oneshot_layer_state(void);
 bool has_oneshot_layer_timed_out(void);
+uint16_t oneshot_next(void);
 
 /* inspect */
 uint8_t has_anymod(void);
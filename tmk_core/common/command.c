@@ -28,6 +28,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "bootloader.h"
 #include "action_layer.h"
 #include "action_util.h"
+#include "action_tapping.h"
 #include "eeconfig.h"
 #include "sleep_led.h"
 #include "led.h"
@@ -244,6 +245,10 @@ static void print_status(void)
     print_val_hex8(keymap_config.nkro);
 #endif
     print_val_hex32(timer_read32());
+#ifndef NO_ACTION_TAPPING
+    print_val_dec(action_tapping_buffer_peak());
+    print_val_dec(action_tapping_buffer_overflows());
+#endif
 
 #ifdef PROTOCOL_PJRC
     print_val_hex8(UDCON);
@@ -0,0 +1,218 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include "deferred_exec.h"
+#include "timer.h"
+
+/*
+ * Scheduled callbacks are kept in a two level timer wheel. The first
+ * level has a slot for each of the next WHEEL_SLOTS ms, the second one a
+ * slot for each of the next WHEEL_SLOTS groups of WHEEL_SLOTS ms. Whenever
+ * the wheel enters a new group, that group's callbacks move down into the
+ * first level, and callbacks further out than the second level reaches
+ * are moved up from the overflow list. Each ms then only looks at one
+ * slot, however many callbacks are waiting.
+ */
+#define WHEEL_BITS 4
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+
+/* lists the tasks can be in, slots of the first level come first */
+#define LIST_LEVEL1 WHEEL_SLOTS
+#define LIST_OVERFLOW (2 * WHEEL_SLOTS)
+#define LIST_COUNT (2 * WHEEL_SLOTS + 1)
+/* not in a list: being run, being run but already rescheduled, free */
+#define LIST_RUNNING 0xFD
+#define LIST_EXTENDED 0xFE
+#define LIST_NONE 0xFF
+
+#define TASK_NONE 0xFF
+
+typedef struct {
+    uint32_t trigger_time;
+    deferred_exec_callback callback;
+    void *cb_arg;
+    deferred_token token;
+    uint8_t list;
+    uint8_t next;
+} deferred_task_t;
+
+static deferred_task_t tasks[DEFERRED_EXEC_TASKS];
+static uint8_t lists[LIST_COUNT];
+static uint8_t task_count = 0;
+static deferred_token last_token = INVALID_DEFERRED_TOKEN;
+static bool initialized = false;
+/* the next ms the wheel runs the callbacks of */
+static uint32_t wheel_time;
+
+static void deferred_exec_init(void)
+{
+    for (uint8_t i = 0; i < LIST_COUNT; i++) lists[i] = TASK_NONE;
+    for (uint8_t i = 0; i < DEFERRED_EXEC_TASKS; i++) tasks[i].list = LIST_NONE;
+    initialized = true;
+}
+
+static void list_insert(uint8_t task)
+{
+    deferred_task_t *t = &tasks[task];
+    uint32_t time = t->trigger_time;
+    if ((int32_t)(time - wheel_time) < 0) time = wheel_time;
+
+    uint8_t list;
+    if (time - wheel_time < WHEEL_SLOTS) {
+        list = time & WHEEL_MASK;
+    } else if ((time >> WHEEL_BITS) - (wheel_time >> WHEEL_BITS) < WHEEL_SLOTS) {
+        list = LIST_LEVEL1 + ((time >> WHEEL_BITS) & WHEEL_MASK);
+    } else {
+        list = LIST_OVERFLOW;
+    }
+    /* appended, so that tasks due at the same time run in order */
+    uint8_t *link = &lists[list];
+    while (*link != TASK_NONE) link = &tasks[*link].next;
+    t->list = list;
+    t->next = TASK_NONE;
+    *link = task;
+}
+
+static void list_remove(uint8_t task)
+{
+    if (tasks[task].list >= LIST_COUNT) return;
+    uint8_t *link = &lists[tasks[task].list];
+    while (*link != task) link = &tasks[*link].next;
+    *link = tasks[task].next;
+    tasks[task].list = LIST_NONE;
+}
+
+/* moves every task of the list to where it belongs now */
+static void list_cascade(uint8_t list)
+{
+    uint8_t task = lists[list];
+    lists[list] = TASK_NONE;
+    while (task != TASK_NONE) {
+        uint8_t next = tasks[task].next;
+        list_insert(task);
+        task = next;
+    }
+}
+
+static uint8_t task_find(deferred_token token)
+{
+    if (token == INVALID_DEFERRED_TOKEN || !initialized) return TASK_NONE;
+    for (uint8_t i = 0; i < DEFERRED_EXEC_TASKS; i++) {
+        if (tasks[i].list != LIST_NONE && tasks[i].token == token) return i;
+    }
+    return TASK_NONE;
+}
+
+deferred_token defer_exec(uint32_t delay_ms, deferred_exec_callback callback, void *cb_arg)
+{
+    if (!delay_ms || !callback) return INVALID_DEFERRED_TOKEN;
+    if (!initialized) deferred_exec_init();
+
+    uint8_t task = 0;
+    while (task < DEFERRED_EXEC_TASKS && tasks[task].list != LIST_NONE) task++;
+    if (task == DEFERRED_EXEC_TASKS) return INVALID_DEFERRED_TOKEN;
+
+    uint32_t now = timer_read32();
+    /* an empty wheel has not been kept up to date */
+    if (!task_count) wheel_time = now;
+
+    do {
+        last_token++;
+    } while (last_token == INVALID_DEFERRED_TOKEN || task_find(last_token) != TASK_NONE);
+
+    deferred_task_t *t = &tasks[task];
+    t->trigger_time = now + delay_ms;
+    t->callback = callback;
+    t->cb_arg = cb_arg;
+    t->token = last_token;
+    list_insert(task);
+    task_count++;
+    return last_token;
+}
+
+bool extend_deferred_exec(deferred_token token, uint32_t delay_ms)
+{
+    uint8_t task = task_find(token);
+    if (task == TASK_NONE || !delay_ms) return false;
+    tasks[task].trigger_time = timer_read32() + delay_ms;
+    if (tasks[task].list >= LIST_COUNT) {
+        /* the task is running, it goes back into the wheel when it returns */
+        tasks[task].list = LIST_EXTENDED;
+    } else {
+        list_remove(task);
+        list_insert(task);
+    }
+    return true;
+}
+
+bool cancel_deferred_exec(deferred_token token)
+{
+    uint8_t task = task_find(token);
+    if (task == TASK_NONE) return false;
+    list_remove(task);
+    tasks[task].list = LIST_NONE;
+    task_count--;
+    return true;
+}
+
+void deferred_exec_task(void)
+{
+    uint32_t now = timer_read32();
+    while (task_count && (int32_t)(now - wheel_time) >= 0) {
+        uint8_t list = wheel_time & WHEEL_MASK;
+        /* callbacks may schedule, extend or cancel others, so the slot
+         * is looked at again after each one */
+        while (lists[list] != TASK_NONE) {
+            uint8_t task = lists[list];
+            deferred_task_t *t = &tasks[task];
+            list_remove(task);
+            t->list = LIST_RUNNING;
+            uint32_t trigger_time = t->trigger_time;
+            uint32_t again = t->callback(trigger_time, t->cb_arg);
+            if (t->list == LIST_EXTENDED) {
+                list_insert(task);
+            } else if (t->list != LIST_RUNNING) {
+                /* cancelled by the callback, and maybe already reused */
+            } else if (again) {
+                t->trigger_time = trigger_time + again;
+                list_insert(task);
+            } else {
+                t->list = LIST_NONE;
+                task_count--;
+            }
+        }
+        wheel_time++;
+        if (!(wheel_time & WHEEL_MASK)) {
+            list_cascade(LIST_LEVEL1 + ((wheel_time >> WHEEL_BITS) & WHEEL_MASK));
+            list_cascade(LIST_OVERFLOW);
+        }
+    }
+}
+
+uint32_t deferred_exec_next(void)
+{
+    if (!task_count) return UINT32_MAX;
+    uint32_t now = timer_read32();
+    uint32_t next = UINT32_MAX;
+    for (uint8_t i = 0; i < DEFERRED_EXEC_TASKS; i++) {
+        if (tasks[i].list >= LIST_COUNT) continue;
+        int32_t left = tasks[i].trigger_time - now;
+        if (left <= 0) return 0;
+        if ((uint32_t)left < next) next = left;
+    }
+    return next;
+}
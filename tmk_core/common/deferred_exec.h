@@ -0,0 +1,55 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEFERRED_EXEC_H
+#define DEFERRED_EXEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* number of callbacks that can be scheduled at the same time */
+#ifndef DEFERRED_EXEC_TASKS
+#define DEFERRED_EXEC_TASKS 8
+#endif
+
+typedef uint8_t deferred_token;
+#define INVALID_DEFERRED_TOKEN 0
+
+/* Called at trigger_time, or as soon after as the keyboard gets to it.
+ * Returns 0 when it is done, or the number of ms after trigger_time
+ * when it wants to be called again. */
+typedef uint32_t (*deferred_exec_callback)(uint32_t trigger_time, void *cb_arg);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* run callback delay_ms from now; returns INVALID_DEFERRED_TOKEN when
+ * delay_ms is 0 or all DEFERRED_EXEC_TASKS are in use */
+deferred_token defer_exec(uint32_t delay_ms, deferred_exec_callback callback, void *cb_arg);
+/* run the scheduled callback delay_ms from now instead */
+bool extend_deferred_exec(deferred_token token, uint32_t delay_ms);
+bool cancel_deferred_exec(deferred_token token);
+
+/* run the callbacks that are due, called from keyboard_task */
+void deferred_exec_task(void);
+/* ms until the next callback is due, UINT32_MAX when none is scheduled */
+uint32_t deferred_exec_next(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
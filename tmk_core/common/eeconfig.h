@@ -34,6 +34,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define EECONFIG_AUDIO                              (uint8_t *)7
 #define EECONFIG_RGBLIGHT                           (uint32_t *)8
 #define EECONFIG_UNICODEMODE                        (uint8_t *)12
+#define EECONFIG_SEND_STRING_LAYOUT                 (uint8_t *)13
+/* bytes used by the settings above, the saved dynamic macros follow */
+#define EECONFIG_SIZE                               16
+#define EECONFIG_DYNAMIC_MACRO                      (uint8_t *)EECONFIG_SIZE
 
 
 /* debug bit */
@@ -16,20 +16,59 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdint.h>
+#include <string.h>
 //#include <avr/interrupt.h>
 #include "keycode.h"
 #include "host.h"
 #include "util.h"
 #include "debug.h"
+#if defined(KEYBOARD_REPORT_COALESCE) || defined(KEYBOARD_REPORT_QUEUE)
+#include "timer.h"
+#endif
+#ifdef KEYBOARD_REPORT_QUEUE
+#include "wait.h"
+#endif
 
 static host_driver_t *driver;
 static uint16_t last_system_report = 0;
 static uint16_t last_consumer_report = 0;
+static report_keyboard_t last_keyboard_report;
+static bool last_keyboard_report_valid = false;
+static uint16_t keyboard_report_suppressed = 0;
+#ifdef KEYBOARD_REPORT_COALESCE
+static report_keyboard_t pending_keyboard_report;
+static bool keyboard_report_pending = false;
+static volatile bool keyboard_frame_started = false;
+static bool keyboard_frame_seen = false;
+static uint16_t keyboard_frame_time = 0;
+#endif
+#ifdef KEYBOARD_REPORT_QUEUE
+typedef struct {
+    report_keyboard_t report;
+    uint8_t delay;
+} queued_report_t;
+
+static queued_report_t report_queue[KEYBOARD_REPORT_QUEUE_SIZE];
+static uint8_t report_queue_head = 0;
+static uint8_t report_queue_count = 0;
+/* when the last queued report was sent, and how long the next one waits */
+static uint16_t report_queue_time = 0;
+static uint8_t report_queue_wait = 0;
+#endif
 
 
 void host_set_driver(host_driver_t *d)
 {
     driver = d;
+    /* a new driver has not seen any report yet */
+    last_keyboard_report_valid = false;
+#ifdef KEYBOARD_REPORT_COALESCE
+    keyboard_frame_seen = false;
+#endif
+#ifdef KEYBOARD_REPORT_QUEUE
+    report_queue_count = 0;
+    report_queue_wait = 0;
+#endif
 }
 
 host_driver_t *host_get_driver(void)
@@ -42,10 +81,16 @@ uint8_t host_keyboard_leds(void)
     if (!driver) return 0;
     return (*driver->keyboard_leds)();
 }
-/* send report */
-void host_keyboard_send(report_keyboard_t *report)
+static void keyboard_send(report_keyboard_t *report)
 {
-    if (!driver) return;
+    if (last_keyboard_report_valid &&
+        memcmp(report->raw, last_keyboard_report.raw, KEYBOARD_REPORT_SIZE) == 0) {
+        keyboard_report_suppressed++;
+        return;
+    }
+    last_keyboard_report = *report;
+    last_keyboard_report_valid = true;
+
     (*driver->send_keyboard)(report);
 
     if (debug_keyboard) {
@@ -57,9 +102,163 @@ void host_keyboard_send(report_keyboard_t *report)
     }
 }
 
+#ifdef KEYBOARD_REPORT_COALESCE
+enum report_change {
+    MODS_ADDED   = 1 << 0,
+    MODS_REMOVED = 1 << 1,
+    KEYS_ADDED   = 1 << 2,
+    KEYS_REMOVED = 1 << 3,
+    KEYS_CHANGED = 1 << 4,
+};
+
+/* Classify the difference between two reports. A key byte that goes
+ * from one non-zero value to another is neither a plain press nor a
+ * plain release in the 6KRO layout, so it is never merged. */
+static uint8_t report_change(report_keyboard_t *from, report_keyboard_t *to)
+{
+    uint8_t change = 0;
+    if (to->raw[0] & ~from->raw[0]) change |= MODS_ADDED;
+    if (from->raw[0] & ~to->raw[0]) change |= MODS_REMOVED;
+    for (uint8_t i = 1; i < KEYBOARD_REPORT_SIZE; i++) {
+        if (from->raw[i] == to->raw[i]) continue;
+        if (!from->raw[i]) {
+            change |= KEYS_ADDED;
+        } else if (!to->raw[i]) {
+            change |= KEYS_REMOVED;
+        } else {
+            change |= KEYS_CHANGED;
+        }
+    }
+    return change;
+}
+
+/* The pending report can be replaced by the next one when both steps
+ * make the same single kind of change, so the host still sees every
+ * press before its release and modifiers before the keys they apply to. */
+static bool keyboard_report_mergeable(report_keyboard_t *report)
+{
+    uint8_t next = report_change(&pending_keyboard_report, report);
+    if (!next) return true;
+    if (next & (next - 1) || next == KEYS_CHANGED) return false;
+
+    report_keyboard_t none = {};
+    return report_change(last_keyboard_report_valid ? &last_keyboard_report : &none,
+                         &pending_keyboard_report) == next;
+}
+
+static void keyboard_flush(void)
+{
+    keyboard_report_pending = false;
+    keyboard_send(&pending_keyboard_report);
+}
+
+void host_keyboard_frame(void)
+{
+    keyboard_frame_started = true;
+}
+
+void host_keyboard_flush(void)
+{
+    if (!keyboard_report_pending || !driver) return;
+    if (keyboard_frame_started) {
+        keyboard_frame_started = false;
+        keyboard_frame_seen = true;
+        keyboard_frame_time = timer_read();
+    } else if (keyboard_frame_seen && timer_elapsed(keyboard_frame_time) < 2) {
+        /* the host has not polled since the last report, wait for the next frame */
+        return;
+    }
+    keyboard_flush();
+}
+#endif
+
+static void keyboard_submit(report_keyboard_t *report)
+{
+#ifdef KEYBOARD_REPORT_COALESCE
+    if (keyboard_report_pending && !keyboard_report_mergeable(report)) {
+        keyboard_flush();
+    }
+    pending_keyboard_report = *report;
+    keyboard_report_pending = true;
+#else
+    keyboard_send(report);
+#endif
+}
+
+#ifdef KEYBOARD_REPORT_QUEUE
+static bool report_queue_due(void)
+{
+    return timer_elapsed(report_queue_time) >= report_queue_wait;
+}
+
+static void report_queue_send(report_keyboard_t *report, uint8_t delay)
+{
+    keyboard_submit(report);
+    report_queue_time = timer_read();
+    report_queue_wait = delay;
+}
+
+static void report_queue_pop(void)
+{
+    queued_report_t *entry = &report_queue[report_queue_head];
+    report_queue_head = (report_queue_head + 1) % KEYBOARD_REPORT_QUEUE_SIZE;
+    report_queue_count--;
+    report_queue_send(&entry->report, entry->delay);
+}
+
+void host_keyboard_queue(report_keyboard_t *report, uint8_t delay)
+{
+    if (!driver) return;
+    if (!report_queue_count && report_queue_due()) {
+        report_queue_send(report, delay);
+        return;
+    }
+    if (report_queue_count == KEYBOARD_REPORT_QUEUE_SIZE) {
+        /* no room, wait for the oldest report to go out */
+        if (!report_queue_due()) {
+            wait_ms(report_queue_wait - timer_elapsed(report_queue_time));
+        }
+        report_queue_pop();
+    }
+    queued_report_t *entry = &report_queue[(report_queue_head + report_queue_count) % KEYBOARD_REPORT_QUEUE_SIZE];
+    entry->report = *report;
+    entry->delay = delay;
+    report_queue_count++;
+}
+
+void host_keyboard_task(void)
+{
+    while (report_queue_count && report_queue_due()) {
+        report_queue_pop();
+    }
+}
+
+bool host_keyboard_queue_empty(void)
+{
+    return !report_queue_count;
+}
+#endif
+
+/* send report */
+void host_keyboard_send(report_keyboard_t *report)
+{
+    if (!driver) return;
+#ifdef KEYBOARD_REPORT_QUEUE
+    /* reports sent while others are queued go after them */
+    if (report_queue_count || !report_queue_due()) {
+        host_keyboard_queue(report, 0);
+        return;
+    }
+#endif
+    keyboard_submit(report);
+}
+
 void host_mouse_send(report_mouse_t *report)
 {
     if (!driver) return;
+#ifdef KEYBOARD_REPORT_COALESCE
+    if (keyboard_report_pending) keyboard_flush();
+#endif
     (*driver->send_mouse)(report);
 }
 
@@ -69,6 +268,9 @@ void host_system_send(uint16_t report)
     last_system_report = report;
 
     if (!driver) return;
+#ifdef KEYBOARD_REPORT_COALESCE
+    if (keyboard_report_pending) keyboard_flush();
+#endif
     (*driver->send_system)(report);
 }
 
@@ -78,6 +280,9 @@ void host_consumer_send(uint16_t report)
     last_consumer_report = report;
 
     if (!driver) return;
+#ifdef KEYBOARD_REPORT_COALESCE
+    if (keyboard_report_pending) keyboard_flush();
+#endif
     (*driver->send_consumer)(report);
 }
 
@@ -90,3 +295,8 @@ uint16_t host_last_consumer_report(void)
 {
     return last_consumer_report;
 }
+
+uint16_t host_keyboard_suppressed_reports(void)
+{
+    return keyboard_report_suppressed;
+}
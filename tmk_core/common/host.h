@@ -45,6 +45,27 @@ void host_consumer_send(uint16_t data);
 
 uint16_t host_last_system_report(void);
 uint16_t host_last_consumer_report(void);
+/* number of keyboard reports dropped for being identical to the last one */
+uint16_t host_keyboard_suppressed_reports(void);
+
+#ifdef KEYBOARD_REPORT_COALESCE
+/* send the keyboard report collected since the last flush */
+void host_keyboard_flush(void);
+/* called on USB start of frame, the host polls at most once per frame */
+void host_keyboard_frame(void);
+#endif
+
+#ifdef KEYBOARD_REPORT_QUEUE
+#ifndef KEYBOARD_REPORT_QUEUE_SIZE
+#define KEYBOARD_REPORT_QUEUE_SIZE 16
+#endif
+/* send the report delay ms after the previous queued one, and keep the
+ * next one delay ms behind it; other keyboard reports wait their turn */
+void host_keyboard_queue(report_keyboard_t *report, uint8_t delay);
+/* send the queued reports that are due */
+void host_keyboard_task(void);
+bool host_keyboard_queue_empty(void);
+#endif
 
 #ifdef __cplusplus
 }
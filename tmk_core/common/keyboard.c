@@ -31,11 +31,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "eeconfig.h"
 #include "backlight.h"
 #include "action_layer.h"
+#include "action_macro.h"
 #ifdef BOOTMAGIC_ENABLE
 #   include "bootmagic.h"
 #else
 #   include "magic.h"
 #endif
+#ifdef DEFERRED_EXEC_ENABLE
+#   include "deferred_exec.h"
+#endif
 #ifdef MOUSEKEY_ENABLE
 #   include "mousekey.h"
 #endif
@@ -61,18 +65,89 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #   include "visualizer/visualizer.h"
 #endif
 
+/* TICKLESS_IDLE_SLEEP implies TICKLESS_IDLE */
+#if defined(TICKLESS_IDLE_SLEEP) && !defined(TICKLESS_IDLE)
+#   define TICKLESS_IDLE
+#endif
+#ifdef TICKLESS_IDLE_SLEEP
+#   include "suspend.h"
+#endif
+
+/* Maximum number of matrix changes handled by one keyboard_task() call.
+ * With the default of 1 every changed key costs a full scan.
+ */
+#ifndef QMK_KEYS_PER_SCAN
+#   define QMK_KEYS_PER_SCAN 1
+#endif
+
+#ifdef TICKLESS_IDLE
+/* Scans since the counters were cleared, and how many of them had neither
+ * a key change nor a timeout to handle.
+ */
+static uint32_t scan_count = 0;
+static uint32_t idle_count = 0;
+
+uint32_t keyboard_scan_count(void) { return scan_count; }
+uint32_t keyboard_idle_count(void) { return idle_count; }
+void keyboard_clear_scan_counts(void) { scan_count = 0; idle_count = 0; }
+#endif
+
+#ifdef TICKLESS_IDLE_SLEEP
+/* How long an idle scan can sleep (ms) before a timeout is due. It is
+ * capped at TICKLESS_IDLE_SLEEP because the matrix is not seen meanwhile.
+ */
+static uint8_t idle_sleep_time(void)
+{
+    uint32_t sleep = TICKLESS_IDLE_SLEEP;
+    uint16_t next = action_tick_next();
+    if (next < sleep) sleep = next;
+    next = action_macro_next();
+    if (next < sleep) sleep = next;
+#ifdef DEFERRED_EXEC_ENABLE
+    uint32_t deferred_next = deferred_exec_next();
+    if (deferred_next < sleep) sleep = deferred_next;
+#endif
+#ifdef MOUSEKEY_ENABLE
+    next = mousekey_next();
+    if (next < sleep) sleep = next;
+#endif
+#ifdef KEYBOARD_REPORT_QUEUE
+    if (!host_keyboard_queue_empty()) sleep = 0;
+#endif
+    return sleep;
+}
+#endif
+
+#if (MATRIX_COLS <= 8)
+#    define matrix_row_ctz(bits)  bitctz(bits)
+#elif (MATRIX_COLS <= 16)
+#    define matrix_row_ctz(bits)  bitctz16(bits)
+#elif (MATRIX_COLS <= 32)
+#    define matrix_row_ctz(bits)  bitctz32(bits)
+#endif
+
 #ifdef MATRIX_HAS_GHOST
 extern const uint16_t keymaps[][MATRIX_ROWS][MATRIX_COLS];
-static matrix_row_t get_real_keys(uint8_t row, matrix_row_t rowdata){
-    matrix_row_t out = 0;
-    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
-        //read each key in the row data and check if the keymap defines it as a real key
-        if (pgm_read_byte(&keymaps[0][row][col]) && (rowdata & (1<<col))){
-            //this creates new row data, if a key is defined in the keymap, it will be set here
-            out |= 1<<col;
+/* Keys that are defined in layer 0 of the keymap, one bit per column.
+ * Blanks (KC_NO) can't be pressed by the user, so they are left out.
+ */
+static matrix_row_t real_keys[MATRIX_ROWS];
+
+static void init_real_keys(void)
+{
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        real_keys[row] = 0;
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            if (pgm_read_word(&keymaps[0][row][col])) {
+                real_keys[row] |= (matrix_row_t)1<<col;
+            }
         }
     }
-    return out;
+}
+
+static inline matrix_row_t get_real_keys(uint8_t row, matrix_row_t rowdata){
+    //this creates new row data, only keys defined in the keymap are kept
+    return rowdata & real_keys[row];
 }
 
 static inline bool popcount_more_than_one(matrix_row_t rowdata)
@@ -119,6 +194,9 @@ void keyboard_setup(void) {
 void keyboard_init(void) {
     timer_init();
     matrix_init();
+#ifdef MATRIX_HAS_GHOST
+    init_real_keys();
+#endif
 #ifdef PS2_MOUSE_ENABLE
     ps2_mouse_init();
 #endif
@@ -145,6 +223,9 @@ void keyboard_init(void) {
 #if defined(NKRO_ENABLE) && defined(FORCE_NKRO)
     keymap_config.nkro = 1;
 #endif
+#ifdef KEYBOARD_REPORT_COALESCE
+    host_keyboard_flush();
+#endif
 }
 
 /*
@@ -160,6 +241,23 @@ void keyboard_task(void)
     static uint8_t led_status = 0;
     matrix_row_t matrix_row = 0;
     matrix_row_t matrix_change = 0;
+#if QMK_KEYS_PER_SCAN > 1
+    /* Changed keys of this scan, queued in row/col order and then
+     * processed in one pass. They all share the time of the scan.
+     */
+    keyevent_t scan_events[QMK_KEYS_PER_SCAN];
+    uint8_t scan_event_count = 0;
+    uint16_t scan_time = timer_read() | 1; /* time should not be 0 */
+#endif
+#ifdef TICKLESS_IDLE
+    bool scan_idle = false;
+    scan_count++;
+#endif
+
+#ifdef DEFERRED_EXEC_ENABLE
+    // callbacks that are due run before the keys of this scan
+    deferred_exec_task();
+#endif
 
     matrix_scan();
     for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
@@ -181,26 +279,62 @@ void keyboard_task(void)
             //matrix_ghost[r] = matrix_row;
 #endif
             if (debug_matrix) matrix_print();
-            for (uint8_t c = 0; c < MATRIX_COLS; c++) {
-                if (matrix_change & ((matrix_row_t)1<<c)) {
-                    action_exec((keyevent_t){
-                        .key = (keypos_t){ .row = r, .col = c },
-                        .pressed = (matrix_row & ((matrix_row_t)1<<c)),
-                        .time = (timer_read() | 1) /* time should not be 0 */
-                    });
-                    // record a processed key
-                    matrix_prev[r] ^= ((matrix_row_t)1<<c);
-                    // process a key per task call
-                    goto MATRIX_LOOP_END;
+            // visit only the changed columns, lowest first
+            for (; matrix_change; matrix_change &= matrix_change - 1) {
+                uint8_t c = matrix_row_ctz(matrix_change);
+#if QMK_KEYS_PER_SCAN > 1
+                scan_events[scan_event_count++] = (keyevent_t){
+                    .key = (keypos_t){ .row = r, .col = c },
+                    .pressed = (matrix_row & ((matrix_row_t)1<<c)),
+                    .time = scan_time
+                };
+                // record a queued key
+                matrix_prev[r] ^= ((matrix_row_t)1<<c);
+                // the rest is picked up by the next task call
+                if (scan_event_count >= QMK_KEYS_PER_SCAN) {
+                    goto MATRIX_SCAN_END;
                 }
+#else
+                action_exec((keyevent_t){
+                    .key = (keypos_t){ .row = r, .col = c },
+                    .pressed = (matrix_row & ((matrix_row_t)1<<c)),
+                    .time = (timer_read() | 1) /* time should not be 0 */
+                });
+                // record a processed key
+                matrix_prev[r] ^= ((matrix_row_t)1<<c);
+                // process a key per task call
+                goto MATRIX_LOOP_END;
+#endif
             }
         }
     }
+#if QMK_KEYS_PER_SCAN > 1
+MATRIX_SCAN_END:
+    if (scan_event_count) {
+        for (uint8_t i = 0; i < scan_event_count; i++) {
+            action_exec(scan_events[i]);
+        }
+        goto MATRIX_LOOP_END;
+    }
+#endif
     // call with pseudo tick event when no real key event.
+#ifdef TICKLESS_IDLE
+    // but only once a timeout is due
+    if (action_tick_next() == 0) {
+        action_exec(TICK);
+    } else {
+        scan_idle = true;
+        idle_count++;
+    }
+#else
     action_exec(TICK);
+#endif
 
 MATRIX_LOOP_END:
 
+    // macros that wait or run long
+    action_macro_task();
+
 #ifdef MOUSEKEY_ENABLE
     // mousekey repeat & acceleration
     mousekey_task();
@@ -226,11 +360,27 @@ MATRIX_LOOP_END:
     visualizer_update(default_layer_state, layer_state, visualizer_get_mods(), host_keyboard_leds());
 #endif
 
+#ifdef KEYBOARD_REPORT_QUEUE
+    host_keyboard_task();
+#endif
+
+#ifdef KEYBOARD_REPORT_COALESCE
+    // send the keyboard report once per scan
+    host_keyboard_flush();
+#endif
+
     // update LED
     if (led_status != host_keyboard_leds()) {
         led_status = host_keyboard_leds();
         keyboard_set_leds(led_status);
     }
+
+#ifdef TICKLESS_IDLE_SLEEP
+    if (scan_idle) {
+        uint8_t sleep = idle_sleep_time();
+        if (sleep) suspend_idle(sleep);
+    }
+#endif
 }
 
 void keyboard_set_leds(uint8_t leds)
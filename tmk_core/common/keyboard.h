@@ -66,6 +66,13 @@ void keyboard_task(void);
 /* it runs when host LED status is updated */
 void keyboard_set_leds(uint8_t leds);
 
+#if defined(TICKLESS_IDLE) || defined(TICKLESS_IDLE_SLEEP)
+/* scans since the counters were cleared, and how many of them were idle */
+uint32_t keyboard_scan_count(void);
+uint32_t keyboard_idle_count(void);
+void keyboard_clear_scan_counts(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
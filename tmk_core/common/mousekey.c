@@ -21,14 +21,25 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "timer.h"
 #include "print.h"
 #include "debug.h"
+#include "progmem.h"
 #include "mousekey.h"
 
 
 
 static report_mouse_t mouse_report = {};
-static uint8_t mousekey_repeat =  0;
 static uint8_t mousekey_accel = 0;
 
+/* Direction of each axis (-1, 0 or 1), and what is left of a unit
+ * from the last report, in 1/256 units.
+ */
+enum { AXIS_X, AXIS_Y, AXIS_V, AXIS_H, AXES };
+static int8_t mousekey_dir[AXES];
+static uint8_t mousekey_frac[AXES];
+
+/* Past the initial delay, and for how long (ms, up to the end of the ramp). */
+static bool mousekey_moving = false;
+static uint16_t mousekey_motion_time = 0;
+
 static void mousekey_debug(void);
 
 
@@ -36,105 +47,174 @@ static void mousekey_debug(void);
  * Mouse keys  acceleration algorithm
  *  http://en.wikipedia.org/wiki/Mouse_keys
  *
- *  speed = delta * max_speed * (repeat / time_to_max)**((1000+curve)/1000)
+ *  speed = delta * max_speed * curve(time / time_to_max)
+ *
+ * The speeds are in units per mk_interval ms. Each report moves by the
+ * distance covered since the previous one, and the fractions of a unit
+ * carry over, so slow motion doesn't stall and fast motion doesn't
+ * need more reports.
  */
 /* milliseconds between the initial key press and first repeated motion event (0-2550) */
 uint8_t mk_delay = MOUSEKEY_DELAY/10;
-/* milliseconds between repeated motion events (0-255) */
+/* milliseconds the speeds are given for (0-255) */
 uint8_t mk_interval = MOUSEKEY_INTERVAL;
-/* steady speed (in action_delta units) applied each event (0-255) */
+/* steady speed (in action_delta units) applied each interval (0-255) */
 uint8_t mk_max_speed = MOUSEKEY_MAX_SPEED;
-/* number of events (count) accelerating to steady speed (0-255) */
+/* number of intervals accelerating to steady speed (0-255) */
 uint8_t mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
-/* ramp used to reach maximum pointer speed (NOT SUPPORTED) */
-//int8_t mk_curve = 0;
 /* wheel params */
 uint8_t mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
 uint8_t mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
 
+/* fraction of the steady speed (0-255) over time_to_max, in even steps */
+static const uint8_t PROGMEM move_curve[] = MOUSEKEY_CURVE;
+static const uint8_t PROGMEM wheel_curve[] = MOUSEKEY_WHEEL_CURVE;
+
 
 static uint16_t last_timer = 0;
 
 
-static uint8_t move_unit(void)
+/* The curve at t of ramp ms, in 1/256. */
+static uint16_t curve_value(const uint8_t *curve, uint8_t len, uint16_t t, uint16_t ramp)
 {
-    uint16_t unit;
-    if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/4;
-    } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/2;
-    } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed);
-    } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_MOVE_DELTA;
-    } else if (mousekey_repeat >= mk_time_to_max) {
-        unit = MOUSEKEY_MOVE_DELTA * mk_max_speed;
-    } else {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed * mousekey_repeat) / mk_time_to_max;
+    if (t >= ramp || len < 2) {
+        return pgm_read_byte(&curve[len - 1]) << 8;
     }
-    return (unit > MOUSEKEY_MOVE_MAX ? MOUSEKEY_MOVE_MAX : (unit == 0 ? 1 : unit));
+    uint32_t pos = (uint32_t)t * (len - 1);
+    uint8_t i = pos / ramp;
+    uint16_t f = pos % ramp;
+    int16_t a = pgm_read_byte(&curve[i]);
+    int16_t b = pgm_read_byte(&curve[i + 1]);
+    return (a << 8) + (int32_t)(b - a) * 256 * f / ramp;
 }
 
-static uint8_t wheel_unit(void)
+/* Distance covered in dt ms around t ms into the motion, in 1/256 units. */
+static uint32_t motion_distance(uint8_t delta, uint8_t max_speed, uint8_t time_to_max, uint8_t unit_max,
+                                const uint8_t *curve, uint8_t len, uint16_t t, uint8_t dt)
 {
-    uint16_t unit;
+    uint8_t interval = mk_interval ? mk_interval : 1;
+    uint16_t unit = delta * max_speed;
+    uint16_t c = 255 << 8;
     if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/4;
+        unit /= 4;
     } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/2;
-    } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed);
-    } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_WHEEL_DELTA;
-    } else if (mousekey_repeat >= mk_wheel_time_to_max) {
-        unit = MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed;
-    } else {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed * mousekey_repeat) / mk_wheel_time_to_max;
+        unit /= 2;
+    } else if (!(mousekey_accel & (1<<2))) {
+        c = curve_value(curve, len, t, (uint16_t)time_to_max * interval);
     }
-    return (unit > MOUSEKEY_WHEEL_MAX ? MOUSEKEY_WHEEL_MAX : (unit == 0 ? 1 : unit));
+    if (unit > unit_max) unit = unit_max;
+
+    uint32_t d = (uint32_t)unit * c * dt / (255UL * interval);
+    /* at least a unit an interval */
+    uint32_t min = (uint32_t)dt * 256 / interval;
+    return d > min ? d : min;
+}
+
+/* Whole units to move an axis by, keeping the rest for later. */
+static int8_t axis_step(uint8_t axis, uint32_t d, uint8_t max)
+{
+    if (!mousekey_dir[axis]) return 0;
+    uint32_t total = d + mousekey_frac[axis];
+    mousekey_frac[axis] = total & 0xFF;
+    total >>= 8;
+    return (int8_t)(total > max ? max : total) * mousekey_dir[axis];
+}
+
+static bool mousekey_active(void)
+{
+    return mousekey_dir[AXIS_X] || mousekey_dir[AXIS_Y] ||
+           mousekey_dir[AXIS_V] || mousekey_dir[AXIS_H];
 }
 
 void mousekey_task(void)
 {
-    if (timer_elapsed(last_timer) < (mousekey_repeat ? mk_interval : mk_delay*10))
+    if (!mousekey_active())
         return;
 
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
+    if (!mousekey_moving) {
+        if (timer_elapsed(last_timer) < mk_delay*10)
+            return;
+        mousekey_moving = true;
+        last_timer += mk_delay*10;
+    }
+
+    uint16_t elapsed = timer_elapsed(last_timer);
+    if (elapsed < MOUSEKEY_REPORT_INTERVAL)
         return;
+    uint8_t dt = elapsed > UINT8_MAX ? UINT8_MAX : elapsed;
+    last_timer = timer_read();
 
-    if (mousekey_repeat != UINT8_MAX)
-        mousekey_repeat++;
+    /* the speed half way through, exact on the straight parts of the curve */
+    uint16_t t = mousekey_motion_time + dt / 2;
+    /* no need to count past the longer ramp, and t can't overflow then */
+    uint8_t time_to_max = mk_time_to_max > mk_wheel_time_to_max ? mk_time_to_max : mk_wheel_time_to_max;
+    uint16_t ramp = (uint16_t)time_to_max * (mk_interval ? mk_interval : 1);
+    if (mousekey_motion_time < ramp) {
+        mousekey_motion_time += dt;
+    }
 
+    uint32_t move = motion_distance(MOUSEKEY_MOVE_DELTA, mk_max_speed, mk_time_to_max, MOUSEKEY_MOVE_MAX,
+                                    move_curve, sizeof(move_curve), t, dt);
+    /* diagonal move [1/sqrt(2) = 181/256] */
+    if (mousekey_dir[AXIS_X] && mousekey_dir[AXIS_Y]) {
+        move = move * 181 / 256;
+    }
+    uint32_t wheel = motion_distance(MOUSEKEY_WHEEL_DELTA, mk_wheel_max_speed, mk_wheel_time_to_max, MOUSEKEY_WHEEL_MAX,
+                                     wheel_curve, sizeof(wheel_curve), t, dt);
 
-    if (mouse_report.x > 0) mouse_report.x = move_unit();
-    if (mouse_report.x < 0) mouse_report.x = move_unit() * -1;
-    if (mouse_report.y > 0) mouse_report.y = move_unit();
-    if (mouse_report.y < 0) mouse_report.y = move_unit() * -1;
+    mouse_report.x = axis_step(AXIS_X, move, MOUSEKEY_MOVE_MAX);
+    mouse_report.y = axis_step(AXIS_Y, move, MOUSEKEY_MOVE_MAX);
+    mouse_report.v = axis_step(AXIS_V, wheel, MOUSEKEY_WHEEL_MAX);
+    mouse_report.h = axis_step(AXIS_H, wheel, MOUSEKEY_WHEEL_MAX);
 
-    /* diagonal move [1/sqrt(2) = 0.7] */
-    if (mouse_report.x && mouse_report.y) {
-        mouse_report.x *= 0.7;
-        mouse_report.y *= 0.7;
-    }
+    /* nothing to send until a whole unit has built up */
+    if (mouse_report.x || mouse_report.y || mouse_report.v || mouse_report.h)
+        mousekey_send();
+}
 
-    if (mouse_report.v > 0) mouse_report.v = wheel_unit();
-    if (mouse_report.v < 0) mouse_report.v = wheel_unit() * -1;
-    if (mouse_report.h > 0) mouse_report.h = wheel_unit();
-    if (mouse_report.h < 0) mouse_report.h = wheel_unit() * -1;
+/* Milliseconds until mousekey_task() has to run again, UINT16_MAX when
+ * nothing is moving.
+ */
+uint16_t mousekey_next(void)
+{
+    if (!mousekey_active())
+        return UINT16_MAX;
 
-    mousekey_send();
+    uint16_t interval = (mousekey_moving ? MOUSEKEY_REPORT_INTERVAL : mk_delay*10);
+    uint16_t elapsed = timer_elapsed(last_timer);
+    return elapsed < interval ? interval - elapsed : 0;
+}
+
+/* Start moving an axis. The first press moves a single step right away. */
+static void mousekey_start(uint8_t axis, int8_t dir, int8_t *field, uint8_t first_step)
+{
+    if (!mousekey_active()) {
+        mousekey_moving = false;
+        mousekey_motion_time = 0;
+        last_timer = timer_read();
+        *field = first_step * dir;
+    }
+    mousekey_dir[axis] = dir;
+    mousekey_frac[axis] = 0;
+}
+
+static void mousekey_stop(uint8_t axis, int8_t dir)
+{
+    if (mousekey_dir[axis] == dir) {
+        mousekey_dir[axis] = 0;
+    }
 }
 
 void mousekey_on(uint8_t code)
 {
-    if      (code == KC_MS_UP)       mouse_report.y = move_unit() * -1;
-    else if (code == KC_MS_DOWN)     mouse_report.y = move_unit();
-    else if (code == KC_MS_LEFT)     mouse_report.x = move_unit() * -1;
-    else if (code == KC_MS_RIGHT)    mouse_report.x = move_unit();
-    else if (code == KC_MS_WH_UP)    mouse_report.v = wheel_unit();
-    else if (code == KC_MS_WH_DOWN)  mouse_report.v = wheel_unit() * -1;
-    else if (code == KC_MS_WH_LEFT)  mouse_report.h = wheel_unit() * -1;
-    else if (code == KC_MS_WH_RIGHT) mouse_report.h = wheel_unit();
+    if      (code == KC_MS_UP)       mousekey_start(AXIS_Y, -1, &mouse_report.y, MOUSEKEY_MOVE_DELTA);
+    else if (code == KC_MS_DOWN)     mousekey_start(AXIS_Y,  1, &mouse_report.y, MOUSEKEY_MOVE_DELTA);
+    else if (code == KC_MS_LEFT)     mousekey_start(AXIS_X, -1, &mouse_report.x, MOUSEKEY_MOVE_DELTA);
+    else if (code == KC_MS_RIGHT)    mousekey_start(AXIS_X,  1, &mouse_report.x, MOUSEKEY_MOVE_DELTA);
+    else if (code == KC_MS_WH_UP)    mousekey_start(AXIS_V,  1, &mouse_report.v, MOUSEKEY_WHEEL_DELTA);
+    else if (code == KC_MS_WH_DOWN)  mousekey_start(AXIS_V, -1, &mouse_report.v, MOUSEKEY_WHEEL_DELTA);
+    else if (code == KC_MS_WH_LEFT)  mousekey_start(AXIS_H, -1, &mouse_report.h, MOUSEKEY_WHEEL_DELTA);
+    else if (code == KC_MS_WH_RIGHT) mousekey_start(AXIS_H,  1, &mouse_report.h, MOUSEKEY_WHEEL_DELTA);
     else if (code == KC_MS_BTN1)     mouse_report.buttons |= MOUSE_BTN1;
     else if (code == KC_MS_BTN2)     mouse_report.buttons |= MOUSE_BTN2;
     else if (code == KC_MS_BTN3)     mouse_report.buttons |= MOUSE_BTN3;
@@ -147,14 +227,14 @@ void mousekey_on(uint8_t code)
 
 void mousekey_off(uint8_t code)
 {
-    if      (code == KC_MS_UP       && mouse_report.y < 0) mouse_report.y = 0;
-    else if (code == KC_MS_DOWN     && mouse_report.y > 0) mouse_report.y = 0;
-    else if (code == KC_MS_LEFT     && mouse_report.x < 0) mouse_report.x = 0;
-    else if (code == KC_MS_RIGHT    && mouse_report.x > 0) mouse_report.x = 0;
-    else if (code == KC_MS_WH_UP    && mouse_report.v > 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_DOWN  && mouse_report.v < 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_LEFT  && mouse_report.h < 0) mouse_report.h = 0;
-    else if (code == KC_MS_WH_RIGHT && mouse_report.h > 0) mouse_report.h = 0;
+    if      (code == KC_MS_UP)       mousekey_stop(AXIS_Y, -1);
+    else if (code == KC_MS_DOWN)     mousekey_stop(AXIS_Y,  1);
+    else if (code == KC_MS_LEFT)     mousekey_stop(AXIS_X, -1);
+    else if (code == KC_MS_RIGHT)    mousekey_stop(AXIS_X,  1);
+    else if (code == KC_MS_WH_UP)    mousekey_stop(AXIS_V,  1);
+    else if (code == KC_MS_WH_DOWN)  mousekey_stop(AXIS_V, -1);
+    else if (code == KC_MS_WH_LEFT)  mousekey_stop(AXIS_H, -1);
+    else if (code == KC_MS_WH_RIGHT) mousekey_stop(AXIS_H,  1);
     else if (code == KC_MS_BTN1) mouse_report.buttons &= ~MOUSE_BTN1;
     else if (code == KC_MS_BTN2) mouse_report.buttons &= ~MOUSE_BTN2;
     else if (code == KC_MS_BTN3) mouse_report.buttons &= ~MOUSE_BTN3;
@@ -164,33 +244,44 @@ void mousekey_off(uint8_t code)
     else if (code == KC_MS_ACCEL1) mousekey_accel &= ~(1<<1);
     else if (code == KC_MS_ACCEL2) mousekey_accel &= ~(1<<2);
 
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
-        mousekey_repeat = 0;
+    if (!mousekey_active()) {
+        mousekey_moving = false;
+        mousekey_motion_time = 0;
+    }
 }
 
 void mousekey_send(void)
 {
     mousekey_debug();
     host_mouse_send(&mouse_report);
-    last_timer = timer_read();
+    /* the motion is relative, don't send it again with the buttons */
+    mouse_report.x = 0;
+    mouse_report.y = 0;
+    mouse_report.v = 0;
+    mouse_report.h = 0;
 }
 
 void mousekey_clear(void)
 {
     mouse_report = (report_mouse_t){};
-    mousekey_repeat = 0;
+    for (uint8_t i = 0; i < AXES; i++) {
+        mousekey_dir[i] = 0;
+        mousekey_frac[i] = 0;
+    }
+    mousekey_moving = false;
+    mousekey_motion_time = 0;
     mousekey_accel = 0;
 }
 
 static void mousekey_debug(void)
 {
     if (!debug_mouse) return;
-    print("mousekey [btn|x y v h](rep/acl): [");
+    print("mousekey [btn|x y v h](ms/acl): [");
     phex(mouse_report.buttons); print("|");
     print_decs(mouse_report.x); print(" ");
     print_decs(mouse_report.y); print(" ");
     print_decs(mouse_report.v); print(" ");
     print_decs(mouse_report.h); print("](");
-    print_dec(mousekey_repeat); print("/");
+    print_dec(mousekey_motion_time); print("/");
     print_dec(mousekey_accel); print(")\n");
 }
@@ -59,6 +59,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MOUSEKEY_WHEEL_TIME_TO_MAX
 #define MOUSEKEY_WHEEL_TIME_TO_MAX 40
 #endif
+/* ms between reports while moving, a multiple of the 1ms USB poll */
+#ifndef MOUSEKEY_REPORT_INTERVAL
+#define MOUSEKEY_REPORT_INTERVAL 8
+#endif
+/* how the speed ramps up to max_speed over time_to_max: the fraction
+ * of max_speed (0-255) at evenly spaced times, straight in between
+ */
+#ifndef MOUSEKEY_CURVE
+#define MOUSEKEY_CURVE { 0, 255 }
+#endif
+#ifndef MOUSEKEY_WHEEL_CURVE
+#define MOUSEKEY_WHEEL_CURVE MOUSEKEY_CURVE
+#endif
 
 
 #ifdef __cplusplus
@@ -74,6 +87,7 @@ extern uint8_t mk_wheel_time_to_max;
 
 
 void mousekey_task(void);
+uint16_t mousekey_next(void);
 void mousekey_on(uint8_t code);
 void mousekey_off(uint8_t code);
 void mousekey_clear(void);
@@ -5,6 +5,7 @@
 #   include <avr/pgmspace.h>
 #else
 #   define PROGMEM
+#   define PSTR(x)              x
 #   define pgm_read_byte(p)     *((unsigned char*)p)
 #   define pgm_read_word(p)     *((uint16_t*)p)
 #endif
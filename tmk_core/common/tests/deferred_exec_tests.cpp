@@ -0,0 +1,204 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <random>
+#include <vector>
+extern "C" {
+#include "deferred_exec.h"
+#include "timer.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+namespace {
+
+struct Call {
+    int id;
+    uint32_t trigger_time;
+    uint32_t time;
+    bool operator==(const Call& other) const {
+        return id == other.id && trigger_time == other.trigger_time && time == other.time;
+    }
+};
+
+std::ostream& operator<<(std::ostream& stream, const Call& run) {
+    return stream << "{" << run.id << ", " << run.trigger_time << ", " << run.time << "}";
+}
+
+std::vector<Call> calls;
+uint32_t repeat = 0;
+
+uint32_t record(uint32_t trigger_time, void* cb_arg) {
+    calls.push_back({(int)(intptr_t)cb_arg, trigger_time, timer_read32()});
+    return repeat;
+}
+
+deferred_token other;
+
+uint32_t cancel_other(uint32_t trigger_time, void* cb_arg) {
+    record(trigger_time, cb_arg);
+    cancel_deferred_exec(other);
+    return 0;
+}
+
+uint32_t schedule_other(uint32_t trigger_time, void* cb_arg) {
+    record(trigger_time, cb_arg);
+    other = defer_exec(3, record, (void*)2);
+    return 0;
+}
+
+}
+
+class DeferredExec : public testing::Test {
+public:
+    DeferredExec() {
+        set_time(1000);
+        calls.clear();
+        repeat = 0;
+    }
+
+    ~DeferredExec() {
+        // Nothing may be left for the next test
+        EXPECT_EQ(deferred_exec_next(), UINT32_MAX);
+    }
+
+    // Runs the task every ms until the given time
+    void run_until(uint32_t time) {
+        while (timer_read32() < time) {
+            advance_time(1);
+            deferred_exec_task();
+        }
+    }
+};
+
+TEST_F(DeferredExec, RunsTheCallbackWhenItIsDue) {
+    defer_exec(10, record, (void*)1);
+    run_until(1009);
+    EXPECT_TRUE(calls.empty());
+    run_until(1010);
+    EXPECT_EQ(calls, std::vector<Call>({{1, 1010, 1010}}));
+    run_until(1100);
+    EXPECT_EQ(calls.size(), 1);
+}
+
+TEST_F(DeferredExec, ReturningAValueRunsItAgain) {
+    repeat = 5;
+    defer_exec(5, record, (void*)1);
+    run_until(1015);
+    repeat = 0;
+    run_until(1100);
+    EXPECT_EQ(calls, std::vector<Call>({{1, 1005, 1005}, {1, 1010, 1010}, {1, 1015, 1015}, {1, 1020, 1020}}));
+}
+
+TEST_F(DeferredExec, CancelledCallbacksDoNotRun) {
+    deferred_token token = defer_exec(10, record, (void*)1);
+    EXPECT_NE(token, INVALID_DEFERRED_TOKEN);
+    run_until(1005);
+    EXPECT_TRUE(cancel_deferred_exec(token));
+    EXPECT_FALSE(cancel_deferred_exec(token));
+    run_until(1100);
+    EXPECT_TRUE(calls.empty());
+}
+
+TEST_F(DeferredExec, ExtendingMovesTheDeadline) {
+    deferred_token token = defer_exec(10, record, (void*)1);
+    run_until(1008);
+    EXPECT_TRUE(extend_deferred_exec(token, 10));
+    run_until(1100);
+    EXPECT_EQ(calls, std::vector<Call>({{1, 1018, 1018}}));
+    EXPECT_FALSE(extend_deferred_exec(token, 10));
+}
+
+TEST_F(DeferredExec, RejectsWhenAllTasksAreInUse) {
+    std::vector<deferred_token> tokens;
+    for (int i = 0; i < DEFERRED_EXEC_TASKS; i++) {
+        tokens.push_back(defer_exec(100, record, (void*)1));
+        EXPECT_NE(tokens.back(), INVALID_DEFERRED_TOKEN);
+    }
+    EXPECT_EQ(defer_exec(100, record, (void*)1), INVALID_DEFERRED_TOKEN);
+    EXPECT_EQ(defer_exec(0, record, (void*)1), INVALID_DEFERRED_TOKEN);
+    for (deferred_token token : tokens) {
+        cancel_deferred_exec(token);
+    }
+}
+
+TEST_F(DeferredExec, CallbacksCanScheduleAndCancelOthers) {
+    defer_exec(5, schedule_other, (void*)1);
+    run_until(1006);
+    EXPECT_EQ(deferred_exec_next(), 2);
+    run_until(1100);
+    EXPECT_EQ(calls, std::vector<Call>({{1, 1005, 1005}, {2, 1008, 1008}}));
+
+    calls.clear();
+    defer_exec(5, cancel_other, (void*)1);
+    other = defer_exec(5, record, (void*)2);
+    run_until(1200);
+    ASSERT_EQ(calls.size(), 1);
+}
+
+TEST_F(DeferredExec, NextTellsHowLongTheKeyboardCanIdle) {
+    EXPECT_EQ(deferred_exec_next(), UINT32_MAX);
+    deferred_token a = defer_exec(700, record, (void*)1);
+    deferred_token b = defer_exec(30, record, (void*)2);
+    EXPECT_EQ(deferred_exec_next(), 30);
+    advance_time(40);
+    EXPECT_EQ(deferred_exec_next(), 0);
+    cancel_deferred_exec(b);
+    EXPECT_EQ(deferred_exec_next(), 660);
+    cancel_deferred_exec(a);
+}
+
+TEST_F(DeferredExec, RunsInOrderWhenTheTaskIsLate) {
+    std::mt19937 rng(7);
+    for (int i = 0; i < DEFERRED_EXEC_TASKS; i++) {
+        defer_exec(1 + rng() % 3000, record, (void*)(intptr_t)i);
+    }
+    // The keyboard only gets to it every now and then
+    while (deferred_exec_next() != UINT32_MAX) {
+        advance_time(37);
+        deferred_exec_task();
+    }
+    ASSERT_EQ(calls.size(), DEFERRED_EXEC_TASKS);
+    for (size_t i = 0; i < calls.size(); i++) {
+        EXPECT_GE(calls[i].time, calls[i].trigger_time);
+        EXPECT_LT(calls[i].time - calls[i].trigger_time, 37);
+        if (i) EXPECT_LE(calls[i - 1].trigger_time, calls[i].trigger_time);
+    }
+}
+
+TEST_F(DeferredExec, EveryDelayRunsOnTime) {
+    // Covers both levels of the wheel and the overflow list, from every
+    // position in the wheel
+    std::mt19937 rng(3);
+    for (int round = 0; round < 300; round++) {
+        uint32_t delay = round < 100 ? round + 1 : 1 + rng() % 5000;
+        advance_time(rng() % 50);
+        uint32_t due = timer_read32() + delay;
+        calls.clear();
+        defer_exec(delay, record, (void*)1);
+        run_until(due + 1);
+        ASSERT_EQ(calls, std::vector<Call>({{1, due, due}})) << "delay " << delay;
+    }
+}
+
+TEST_F(DeferredExec, SurvivesTheTimerWrappingAround) {
+    set_time(0xFFFFFFF0);
+    defer_exec(40, record, (void*)1);
+    for (int i = 0; i < 50; i++) {
+        advance_time(1);
+        deferred_exec_task();
+    }
+    EXPECT_EQ(calls, std::vector<Call>({{1, 0x18, 0x18}}));
+}
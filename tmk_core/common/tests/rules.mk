@@ -0,0 +1,8 @@
+tmk_util_SRC :=\
+	$(TMK_PATH)/common/tests/util_tests.cpp \
+	$(TMK_PATH)/common/util.c
+
+tmk_deferred_exec_SRC :=\
+	$(TMK_PATH)/common/tests/deferred_exec_tests.cpp \
+	$(TMK_PATH)/common/deferred_exec.c \
+	$(TMK_PATH)/common/test/timer.c
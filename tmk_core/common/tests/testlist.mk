@@ -0,0 +1,3 @@
+TEST_LIST +=\
+	tmk_util \
+	tmk_deferred_exec
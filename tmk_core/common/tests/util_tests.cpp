@@ -0,0 +1,149 @@
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+extern "C" {
+#include "util.h"
+}
+
+namespace {
+
+uint8_t naive_ctz(uint32_t bits) {
+    for (uint8_t i = 0; i < 32; i++) {
+        if (bits & (1UL << i)) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+uint8_t naive_pop(uint32_t bits) {
+    uint8_t c = 0;
+    for (uint8_t i = 0; i < 32; i++) {
+        c += (bits >> i) & 1;
+    }
+    return c;
+}
+
+uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    // No cycle counter, use nanoseconds instead
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+const int rows = 8;
+const int scans = 200000;
+volatile uint32_t sink;
+
+uint8_t ctz(uint8_t bits) { return bitctz(bits); }
+uint8_t ctz(uint16_t bits) { return bitctz16(bits); }
+uint8_t ctz(uint32_t bits) { return bitctz32(bits); }
+
+// One matrix scan over rows with a single changed key, the way keyboard_task
+// walks the row bitmaps, either testing every column or visiting only the
+// changed ones.
+template<typename row_t, bool bit_scan>
+double cycles_per_scan() {
+    const int cols = sizeof(row_t) * 8;
+    row_t matrix[rows] = {};
+    row_t prev[rows] = {};
+    uint64_t start = read_cycles();
+    for (int s = 0; s < scans; s++) {
+        matrix[s % rows] ^= (row_t)1 << (s % cols);
+        for (int r = 0; r < rows; r++) {
+            row_t change = matrix[r] ^ prev[r];
+            if (!change) {
+                continue;
+            }
+            if (bit_scan) {
+                for (; change; change &= change - 1) {
+                    sink = ctz(change);
+                }
+            } else {
+                for (int c = 0; c < cols; c++) {
+                    if (change & ((row_t)1 << c)) {
+                        sink = c;
+                    }
+                }
+            }
+            prev[r] = matrix[r];
+        }
+    }
+    return (double)(read_cycles() - start) / scans;
+}
+
+template<typename row_t>
+void report() {
+    double column_loop = cycles_per_scan<row_t, false>();
+    double bit_scan = cycles_per_scan<row_t, true>();
+    printf("%2d columns: column loop %6.1f, bit scan %6.1f cycles per scan\n",
+        (int)sizeof(row_t) * 8, column_loop, bit_scan);
+}
+
+}
+
+TEST(Util, bitctz_finds_lowest_on_bit) {
+    std::mt19937 rng(1);
+    for (int i = 0; i < 10000; i++) {
+        uint32_t v = rng();
+        EXPECT_EQ(bitctz(v & 0xFF), naive_ctz(v & 0xFF));
+        EXPECT_EQ(bitctz16(v & 0xFFFF), naive_ctz(v & 0xFFFF));
+        EXPECT_EQ(bitctz32(v), naive_ctz(v));
+    }
+    for (int i = 0; i < 32; i++) {
+        EXPECT_EQ(bitctz32(1UL << i), i);
+    }
+}
+
+TEST(Util, bitctz_returns_zero_for_no_bits) {
+    EXPECT_EQ(bitctz(0), 0);
+    EXPECT_EQ(bitctz16(0), 0);
+    EXPECT_EQ(bitctz32(0), 0);
+}
+
+TEST(Util, bitpop_counts_on_bits) {
+    std::mt19937 rng(2);
+    for (int i = 0; i < 10000; i++) {
+        uint32_t v = rng();
+        EXPECT_EQ(bitpop(v & 0xFF), naive_pop(v & 0xFF));
+        EXPECT_EQ(bitpop16(v & 0xFFFF), naive_pop(v & 0xFFFF));
+        EXPECT_EQ(bitpop32(v), naive_pop(v));
+    }
+}
+
+TEST(Util, bit_scan_visits_every_on_bit_in_order) {
+    uint32_t bits = 0x80012408;
+    std::vector<uint8_t> visited;
+    for (; bits; bits &= bits - 1) {
+        visited.push_back(bitctz32(bits));
+    }
+    EXPECT_EQ(visited, (std::vector<uint8_t>{3, 10, 13, 16, 31}));
+}
+
+TEST(Util, benchmark_scan_loop) {
+    report<uint8_t>();
+    report<uint16_t>();
+    report<uint32_t>();
+}
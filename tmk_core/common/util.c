@@ -20,6 +20,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // bit population - return number of on-bit
 uint8_t bitpop(uint8_t bits)
 {
+#if !defined(__AVR__)
+    return __builtin_popcount(bits);
+#else
     uint8_t c;
     for (c = 0; bits; c++)
         bits &= bits - 1;
@@ -28,22 +31,31 @@ uint8_t bitpop(uint8_t bits)
     const uint8_t bit_count[] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
     return bit_count[bits>>4] + bit_count[bits&0x0F]
 */
+#endif
 }
 
 uint8_t bitpop16(uint16_t bits)
 {
+#if !defined(__AVR__)
+    return __builtin_popcount(bits);
+#else
     uint8_t c;
     for (c = 0; bits; c++)
         bits &= bits - 1;
     return c;
+#endif
 }
 
 uint8_t bitpop32(uint32_t bits)
 {
+#if !defined(__AVR__)
+    return __builtin_popcountl(bits);
+#else
     uint8_t c;
     for (c = 0; bits; c++)
         bits &= bits - 1;
     return c;
+#endif
 }
 
 // most significant on-bit - return highest location of on-bit
@@ -79,6 +91,48 @@ uint8_t biton32(uint32_t bits)
 }
 
 
+// least significant on-bit - return lowest location of on-bit (count trailing zeros)
+// NOTE: return 0 when bit0 is on or all bits are off
+// To visit every on-bit: for (; bits; bits &= bits - 1) { n = bitctz(bits); ... }
+uint8_t bitctz(uint8_t bits)
+{
+#if !defined(__AVR__)
+    return bits ? __builtin_ctz(bits) : 0;
+#else
+    uint8_t n = 0;
+    if (!bits) return 0;
+    if (!(bits & 0x0f)) { bits >>= 4; n += 4;}
+    if (!(bits & 0x03)) { bits >>= 2; n += 2;}
+    if (!(bits & 0x01)) { n += 1;}
+    return n;
+#endif
+}
+
+uint8_t bitctz16(uint16_t bits)
+{
+#if !defined(__AVR__)
+    return bits ? __builtin_ctz(bits) : 0;
+#else
+    uint8_t n = 0;
+    if (!bits) return 0;
+    if (!(bits & 0x00ff)) { bits >>= 8; n += 8;}
+    return n + bitctz(bits);
+#endif
+}
+
+uint8_t bitctz32(uint32_t bits)
+{
+#if !defined(__AVR__)
+    return bits ? __builtin_ctzl(bits) : 0;
+#else
+    uint8_t n = 0;
+    if (!bits) return 0;
+    if (!(bits & 0x0000ffff)) { bits >>= 16; n += 16;}
+    return n + bitctz16(bits);
+#endif
+}
+
+
 
 uint8_t bitrev(uint8_t bits)
 {
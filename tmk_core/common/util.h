@@ -35,6 +35,9 @@ uint8_t bitpop32(uint32_t bits);
 uint8_t biton(uint8_t bits);
 uint8_t biton16(uint16_t bits);
 uint8_t biton32(uint32_t bits);
+uint8_t bitctz(uint8_t bits);
+uint8_t bitctz16(uint16_t bits);
+uint8_t bitctz32(uint32_t bits);
 
 uint8_t  bitrev(uint8_t bits);
 uint16_t bitrev16(uint16_t bits);
@@ -1075,6 +1075,9 @@ void nkro_in_cb(USBDriver *usbp, usbep_t ep) {
  *  so that this is not going to have to be checked every 1ms */
 void kbd_sof_cb(USBDriver *usbp) {
   (void)usbp;
+#ifdef KEYBOARD_REPORT_COALESCE
+  host_keyboard_frame();
+#endif
 }
 
 /* Idle requests timer code
@@ -387,10 +387,17 @@ static bool console_flush = false;
     console_flush = b; \
   } \
 } while (0)
+#endif
 
+#if defined(CONSOLE_ENABLE) || defined(KEYBOARD_REPORT_COALESCE)
 // called every 1ms
 void EVENT_USB_Device_StartOfFrame(void)
 {
+#ifdef KEYBOARD_REPORT_COALESCE
+    host_keyboard_frame();
+#endif
+
+#ifdef CONSOLE_ENABLE
     static uint8_t count;
     if (++count % 50) return;
     count = 0;
@@ -398,8 +405,8 @@ void EVENT_USB_Device_StartOfFrame(void)
     if (!console_flush) return;
     Console_Task();
     console_flush = false;
+#endif
 }
-
 #endif
 
 /** Event handler for the USB_ConfigurationChanged event.
@@ -1100,7 +1107,7 @@ static void setup_usb(void)
 
     USB_Init();
 
-    // for Console_Task
+    // for Console_Task and keyboard report coalescing
     USB_Device_EnableSOFEvents();
     print_set_sendchar(sendchar);
 }